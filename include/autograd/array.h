@@ -0,0 +1,95 @@
+#if !defined(__ARRAY_H__)
+#define __ARRAY_H__
+
+#include "autograd/variable.h"
+#include <memory>
+#include <vector>
+
+namespace autograd {
+
+// A list of variables with elementwise operations. Arrays created from
+// values allocate all their variables in one block, so that `values()` and
+// `grads()` can be read and written as arrays with a stride of `stride()`
+// bytes instead of going through every variable.
+template <typename T> class BasicVariableArray {
+  std::shared_ptr<BasicVariable<T>[]> block_;
+  std::vector<std::shared_ptr<BasicVariable<T>>> variables_;
+
+public:
+  using grad_type = acc_type<T>;
+
+  BasicVariableArray() = default;
+
+  BasicVariableArray(const grad_type *values, size_t size);
+
+  explicit BasicVariableArray(
+      std::vector<std::shared_ptr<BasicVariable<T>>> variables)
+      : variables_(std::move(variables)) {}
+
+  size_t size() const { return variables_.size(); }
+
+  const std::shared_ptr<BasicVariable<T>> &operator[](size_t i) const {
+    return variables_[i];
+  }
+
+  const std::vector<std::shared_ptr<BasicVariable<T>>> &variables() const {
+    return variables_;
+  }
+
+  // The block owning the variables, null unless the array was created from
+  // values.
+  const std::shared_ptr<BasicVariable<T>[]> &block() const { return block_; }
+
+  bool contiguous() const { return block_ != nullptr; }
+
+  static constexpr size_t stride() { return sizeof(BasicVariable<T>); }
+
+  T *values() { return block_ ? &block_[0].value_ : nullptr; }
+
+  grad_type *grads() { return block_ ? &block_[0].grad_ : nullptr; }
+
+  void set_requires_grad(bool requires_grad);
+
+  void zero_grad();
+
+  BasicVariableArray log() const;
+  BasicVariableArray relu() const;
+  BasicVariableArray sigmoid() const;
+
+  std::shared_ptr<BasicVariable<T>> sum() const;
+};
+
+using VariableArray = BasicVariableArray<float>;
+
+template <typename T>
+BasicVariableArray<T> operator+(const BasicVariableArray<T> &lhs,
+                                const BasicVariableArray<T> &rhs);
+template <typename T>
+BasicVariableArray<T> operator-(const BasicVariableArray<T> &lhs,
+                                const BasicVariableArray<T> &rhs);
+template <typename T>
+BasicVariableArray<T> operator*(const BasicVariableArray<T> &lhs,
+                                const BasicVariableArray<T> &rhs);
+template <typename T>
+BasicVariableArray<T> operator/(const BasicVariableArray<T> &lhs,
+                                const BasicVariableArray<T> &rhs);
+
+template <typename T>
+BasicVariableArray<T> operator+(const BasicVariableArray<T> &lhs,
+                                const std::shared_ptr<BasicVariable<T>> &rhs);
+template <typename T>
+BasicVariableArray<T> operator-(const BasicVariableArray<T> &lhs,
+                                const std::shared_ptr<BasicVariable<T>> &rhs);
+template <typename T>
+BasicVariableArray<T> operator*(const BasicVariableArray<T> &lhs,
+                                const std::shared_ptr<BasicVariable<T>> &rhs);
+template <typename T>
+BasicVariableArray<T> operator/(const BasicVariableArray<T> &lhs,
+                                const std::shared_ptr<BasicVariable<T>> &rhs);
+
+template <typename T>
+BasicVariableArray<T> operator-(const BasicVariableArray<T> &array);
+
+} // namespace autograd
+
+#endif // __ARRAY_H__
@@ -1,37 +1,172 @@
 #if !defined(__AUTOGRAD_H__)
 #define __AUTOGRAD_H__
 
+#include "autograd/kernels.h"
+#include "autograd/memory.h"
 #include "autograd/variable.h"
 #include <boost/log/trivial.hpp>
+#include <cstdint>
+#include <iosfwd>
 #include <memory>
 #include <vector>
 
 namespace autograd {
 
-using variable_list = std::vector<Variable>;
+// Gradients flowing through the backward graph of BasicVariable<T> are kept
+// in the accumulation type of T.
+template <typename T>
+using variable_list = std::vector<BasicVariable<acc_type<T>>>;
 using edge_list = std::vector<Edge>;
 
+template <typename T> class BasicNode;
+template <typename T> class AddBackward;
+template <typename T> class SubBackward;
+template <typename T> class MulBackward;
+template <typename T> class DivBackward;
+template <typename T> class PowBackward;
+template <typename T> class LogBackward;
+template <typename T> class ReLUBackward;
+template <typename T> class NegBackward;
+template <typename T> class AccumulateGrad;
+
+// The backward engine dispatches on `opcode` and only calls apply() for
+// Custom nodes, the other opcodes are reserved for the nodes in operators.h:
+// the engine casts to their types, so only they can pass an opcode. Every
+// node is a BasicNode<T>, the engine calls apply() through it.
+// `bytes` is only used for memory_stats() and graph_stats().
 class Node : public std::enable_shared_from_this<Node> {
+  template <typename T> friend class BasicNode;
+
   Node(Node const &) = delete;
   Node(Node &&) = delete;
   Node &operator=(Node const &) = delete;
   edge_list next_edges_;
   int input_nr_ = 0;
+  OpCode opcode_;
+  size_t bytes_;
+
+  Node(OpCode opcode, size_t bytes) : opcode_(opcode), bytes_(bytes) {
+    track_node(opcode_, bytes_, 1);
+  }
 
 public:
-  Node() = default;
-  virtual ~Node() = default;
-  virtual const char *name() { return typeid(*this).name(); }
-  void add_next_edge(Edge &&edge) { next_edges_.push_back(edge); }
+  virtual ~Node() {
+    track_edges(-(int64_t)next_edges_.size());
+    track_node(opcode_, bytes_, -1);
+  }
+  virtual const char *name() {
+    return opcode_ == OpCode::Custom ? typeid(*this).name()
+                                     : opcode_name(opcode_);
+  }
+  // Bytes of the forward values kept alive for the backward pass.
+  virtual size_t saved_bytes() const { return 0; }
+  OpCode opcode() const { return opcode_; }
+  size_t bytes() const { return bytes_; }
+  void add_next_edge(Edge &&edge) {
+    next_edges_.push_back(edge);
+    track_edges(1);
+  }
   int next_edges() { return next_edges_.size(); }
   int input_nr() { return input_nr_; }
-  int add_input_nr() { ++input_nr_; }
-  Edge next_edge(int i) { return next_edges_[i]; }
-  virtual variable_list apply(variable_list &&variables) {}
+  int add_input_nr() { return ++input_nr_; }
+  const Edge &next_edge(int i) const { return next_edges_[i]; }
+};
+
+template <typename T> class BasicNode : public Node {
+  friend class AddBackward<T>;
+  friend class SubBackward<T>;
+  friend class MulBackward<T>;
+  friend class DivBackward<T>;
+  friend class PowBackward<T>;
+  friend class LogBackward<T>;
+  friend class ReLUBackward<T>;
+  friend class NegBackward<T>;
+  friend class AccumulateGrad<T>;
+
+  BasicNode(OpCode opcode, size_t bytes) : Node(opcode, bytes) {}
+
+public:
+  BasicNode() : Node(OpCode::Custom, sizeof(BasicNode)) {}
+  virtual variable_list<T> apply(variable_list<T> &&variables) = 0;
+};
+
+// `grad` seeds the backward pass, e.g. with a loss scale.
+template <typename T>
+void run_backward(BasicVariable<T> &root, acc_type<T> grad = 1);
+
+struct GraphExportOptions {
+  enum class Format {
+    Dot,
+    // Binary, native byte order: an EdgeListHeader, then for every node in
+    // id order its OpCode (uint8_t), the number of outgoing edges (uint32_t)
+    // and the ids of their targets (uint32_t each).
+    EdgeList,
+  };
+  Format format = Format::Dot;
+  // Nodes are numbered breadth-first from the root, which has id 0 and depth
+  // 0. Nodes beyond the limits, and the edges to them, are left out.
+  size_t max_depth = SIZE_MAX;
+  size_t max_nodes = SIZE_MAX;
 };
 
-void run_backward(Variable &root);
-void print_graph(Variable &root);
+constexpr char kEdgeListMagic[8] = {'A', 'G', 'E', 'D', 'G', 'E', 'S', 0};
+constexpr uint32_t kEdgeListVersion = 1;
+
+struct EdgeListHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+};
+
+// Streams the backward graph reachable from `root` through a buffer. Memory
+// is O(nodes) for the BFS queue and the id and depth of every node, but no
+// per-node strings. Returns the number of nodes written.
+size_t export_graph(std::shared_ptr<Node> root, std::ostream &out,
+                    const GraphExportOptions &options = {});
+size_t export_graph(std::shared_ptr<Node> root, int fd,
+                    const GraphExportOptions &options = {});
+
+template <typename T>
+size_t export_graph(BasicVariable<T> &root, std::ostream &out,
+                    const GraphExportOptions &options = {}) {
+  return export_graph(root.gradient_edge().grad_fn(), out, options);
+}
+
+// Writes the graph in `dot` format to standard output.
+void print_graph(std::shared_ptr<Node> root);
+
+template <typename T> void print_graph(BasicVariable<T> &root) {
+  print_graph(root.gradient_edge().grad_fn());
+}
+
+// Shape of the backward graph reachable from a root. Nodes are put on levels
+// by the longest path from the root to them, the root is on level 0.
+struct GraphStats {
+  size_t nodes = 0;
+  size_t edges = 0;
+  // The number of levels, i.e. the nodes on the longest path.
+  size_t depth = 0;
+  // The most nodes on the same level.
+  size_t width = 0;
+  // fan_in[k] is the number of nodes with k incoming edges, fan_out[k] the
+  // number of nodes with k outgoing edges.
+  std::vector<size_t> fan_in;
+  std::vector<size_t> fan_out;
+  // Custom nodes are counted as sizeof(BasicNode<T>), without the members
+  // of the subclass.
+  size_t node_bytes = 0;
+  size_t saved_bytes = 0;
+  size_t nodes_by_op[kNumOpCodes] = {};
+};
+
+// Walks the edges without synchronization: call it from the thread that
+// builds and runs the graph, e.g. between training steps. Other threads can
+// poll memory_stats() instead.
+GraphStats graph_stats(std::shared_ptr<Node> root);
+
+template <typename T> GraphStats graph_stats(BasicVariable<T> &root) {
+  return graph_stats(root.gradient_edge().grad_fn());
+}
 
 } // namespace autograd
 
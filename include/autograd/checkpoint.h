@@ -0,0 +1,151 @@
+#if !defined(__CHECKPOINT_H__)
+#define __CHECKPOINT_H__
+
+#include "autograd/mapped_file.h"
+#include "autograd/optimizer.h"
+#include "autograd/variable.h"
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace autograd {
+
+// Checkpoint file layout (native byte order):
+//
+//   CheckpointHeader                      at offset 0
+//   data sections                         each aligned to kCheckpointAlignment
+//   CheckpointEntry[num_entries]          at index_offset
+//
+// The index is written last so that the data can be streamed out without
+// knowing the number of entries up front.
+constexpr char kCheckpointMagic[8] = {'A', 'G', 'C', 'K', 'P', 'T', 0, 0};
+constexpr uint32_t kCheckpointVersion = 1;
+constexpr uint32_t kCheckpointAlignment = 64;
+
+enum class EntryKind : uint32_t {
+  Values = 0,
+  Grads = 1,
+  Optimizer = 2,
+};
+
+struct CheckpointHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t alignment;
+  uint64_t num_entries;
+  uint64_t index_offset;
+  uint64_t file_size;
+  uint8_t reserved[24];
+};
+
+struct CheckpointEntry {
+  char name[40];
+  EntryKind kind;
+  ScalarType dtype;
+  uint64_t count;
+  uint64_t offset;
+};
+
+static_assert(sizeof(CheckpointHeader) == 64, "");
+static_assert(sizeof(CheckpointEntry) == 64, "");
+
+class CheckpointWriter {
+  CheckpointWriter(CheckpointWriter const &) = delete;
+  CheckpointWriter &operator=(CheckpointWriter const &) = delete;
+
+  std::string path_;
+  std::ofstream out_;
+  std::vector<CheckpointEntry> entries_;
+
+  void write_section(const std::string &name, EntryKind kind,
+                     ScalarType dtype, const void *data, size_t count,
+                     size_t element_size);
+  void align();
+
+  template <typename T>
+  void add_parameters(const std::string &name,
+                      const std::shared_ptr<BasicVariable<T>> *parameters,
+                      size_t count);
+
+public:
+  explicit CheckpointWriter(const std::string &path);
+  ~CheckpointWriter();
+
+  // Writes the values and the grads of the parameters as two entries.
+  template <typename T>
+  void add_parameters(const std::string &name,
+                      const std::vector<std::shared_ptr<BasicVariable<T>>> &
+                          parameters) {
+    add_parameters(name, parameters.data(), parameters.size());
+  }
+
+  template <typename T, size_t N>
+  void add_parameters(const std::string &name,
+                      std::shared_ptr<BasicVariable<T>> (&parameters)[N]) {
+    add_parameters(name, parameters, N);
+  }
+
+  void add_optimizer(const std::string &name, const SGD &sgd);
+  void add_grad_scaler(const std::string &name, const GradScaler &scaler);
+
+  // Writes the index and the header. Called by the destructor if needed,
+  // but only an explicit call reports errors.
+  void close();
+};
+
+// A checkpoint mapped into memory. `data` points straight into the mapping;
+// the `load_*` helpers copy into existing variables and optimizers.
+class Checkpoint {
+  MappedFile file_;
+  const CheckpointHeader *header_ = nullptr;
+  const CheckpointEntry *entries_ = nullptr;
+
+  const CheckpointEntry &get(const std::string &name, EntryKind kind,
+                             ScalarType dtype) const;
+
+  template <typename T>
+  void load_parameters(const std::string &name,
+                       const std::shared_ptr<BasicVariable<T>> *parameters,
+                       size_t count) const;
+
+public:
+  explicit Checkpoint(const std::string &path);
+
+  size_t num_entries() const { return header_->num_entries; }
+
+  const CheckpointEntry &entry(size_t i) const { return entries_[i]; }
+
+  const CheckpointEntry *find(const std::string &name, EntryKind kind) const;
+
+  template <typename T> const T *data(const CheckpointEntry &entry) const {
+    if (entry.dtype != scalar_type_of<T>::value) {
+      throw std::runtime_error("Checkpoint entry has a different dtype");
+    }
+    return reinterpret_cast<const T *>(file_.data() + entry.offset);
+  }
+
+  template <typename T>
+  void
+  load_parameters(const std::string &name,
+                  const std::vector<std::shared_ptr<BasicVariable<T>>> &
+                      parameters) const {
+    load_parameters(name, parameters.data(), parameters.size());
+  }
+
+  template <typename T, size_t N>
+  void load_parameters(const std::string &name,
+                       std::shared_ptr<BasicVariable<T>> (&parameters)[N])
+      const {
+    load_parameters(name, parameters, N);
+  }
+
+  void load_optimizer(const std::string &name, SGD &sgd) const;
+  void load_grad_scaler(const std::string &name, GradScaler &scaler) const;
+};
+
+} // namespace autograd
+
+#endif // __CHECKPOINT_H__
@@ -0,0 +1,171 @@
+#if !defined(__DATA_H__)
+#define __DATA_H__
+
+#include "autograd/array.h"
+#include "autograd/mapped_file.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace autograd {
+
+// Rows of `width()` floats, e.g. the features of a sample followed by its
+// target.
+class Dataset {
+public:
+  virtual ~Dataset() = default;
+  virtual size_t size() const = 0;
+  virtual size_t width() const = 0;
+  // Copies row `i` to `row[0..width())`.
+  virtual void read(size_t i, float *row) const = 0;
+};
+
+// Native-endian float32 rows, back to back, without a header.
+class BinaryDataset : public Dataset {
+  MappedFile file_;
+  size_t width_;
+
+public:
+  BinaryDataset(const std::string &path, size_t width);
+
+  size_t size() const override;
+  size_t width() const override { return width_; }
+  void read(size_t i, float *row) const override;
+};
+
+// Comma separated numbers, one row per line. The file is only scanned for
+// line starts when it is opened, rows are parsed when they are read.
+class CsvDataset : public Dataset {
+  MappedFile file_;
+  std::vector<size_t> lines_;
+  size_t width_ = 0;
+  bool header_;
+
+public:
+  explicit CsvDataset(const std::string &path, bool header = false);
+
+  size_t size() const override { return lines_.size(); }
+  size_t width() const override { return width_; }
+  void read(size_t i, float *row) const override;
+};
+
+// Bounded queue for exactly one producer and one consumer thread. push and
+// pop never block, they fail when the queue is full or empty.
+template <typename T> class SpscQueue {
+  SpscQueue(SpscQueue const &) = delete;
+  SpscQueue &operator=(SpscQueue const &) = delete;
+
+  std::vector<T> slots_;
+  alignas(64) std::atomic<size_t> head_{0};
+  alignas(64) std::atomic<size_t> tail_{0};
+
+public:
+  explicit SpscQueue(size_t capacity) : slots_(capacity + 1) {}
+
+  // `value` is left untouched when the queue is full.
+  bool push(T &&value) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t next = tail + 1 == slots_.size() ? 0 : tail + 1;
+    if (next == head_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    slots_[tail] = std::move(value);
+    tail_.store(next, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(T &value) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    value = std::move(slots_[head]);
+    head_.store(head + 1 == slots_.size() ? 0 : head + 1,
+                std::memory_order_release);
+    return true;
+  }
+};
+
+// `rows` samples as leaf variables that do not require grad, row-major.
+class Batch {
+  size_t rows_;
+  size_t width_;
+  VariableArray values_;
+
+public:
+  Batch(const float *values, size_t rows, size_t width);
+
+  size_t rows() const { return rows_; }
+  size_t width() const { return width_; }
+
+  const std::shared_ptr<Variable> &operator()(size_t row,
+                                              size_t column) const {
+    return values_[row * width_ + column];
+  }
+
+  const VariableArray &values() const { return values_; }
+};
+
+struct DataLoaderOptions {
+  size_t batch_size = 32;
+  // Rows held back for shuffling, 0 keeps the order of the dataset.
+  size_t shuffle_buffer = 0;
+  // Batches that are assembled ahead of the training loop.
+  size_t prefetch = 4;
+  bool drop_last = false;
+  uint64_t seed = 0;
+};
+
+// One pass over a dataset. A background thread reads the rows in order,
+// shuffles them through a buffer of `shuffle_buffer` rows and assembles the
+// batches, so that reading overlaps with the training step.
+//
+//   DataLoader loader(dataset, options);
+//   while (auto batch = loader.next()) {
+//     auto loss = model.forward(*batch);
+//     ...
+//   }
+class DataLoader {
+  DataLoader(DataLoader const &) = delete;
+  DataLoader &operator=(DataLoader const &) = delete;
+
+  std::shared_ptr<const Dataset> dataset_;
+  DataLoaderOptions options_;
+  // A null batch marks the end of the pass.
+  SpscQueue<std::unique_ptr<Batch>> queue_;
+  // Batches are handed over through the queue without a lock. Only a side
+  // that finds the queue full (empty) takes the mutex, raises its flag and
+  // waits, and the other side wakes it after its next push (pop).
+  std::mutex mutex_;
+  std::condition_variable not_full_;
+  std::condition_variable not_empty_;
+  std::atomic<bool> producer_waiting_{false};
+  std::atomic<bool> consumer_waiting_{false};
+  std::atomic<bool> stop_{false};
+  bool done_ = false;
+  std::exception_ptr error_;
+  std::thread thread_;
+
+  bool push(std::unique_ptr<Batch> batch);
+  void wake(std::atomic<bool> &waiting, std::condition_variable &cv);
+  void run();
+
+public:
+  DataLoader(std::shared_ptr<const Dataset> dataset,
+             const DataLoaderOptions &options = {});
+  ~DataLoader();
+
+  // Waits for the next batch, returns null after the last one. Errors of
+  // the background thread are rethrown here.
+  std::unique_ptr<Batch> next();
+};
+
+} // namespace autograd
+
+#endif // __DATA_H__
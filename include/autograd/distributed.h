@@ -0,0 +1,71 @@
+#if !defined(__DISTRIBUTED_H__)
+#define __DISTRIBUTED_H__
+
+#include "autograd/parameters.h"
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace autograd {
+
+struct ShmHeader;
+
+// Collectives between processes on the same host through a POSIX
+// shared-memory segment. Rank 0 creates the segment, the other ranks attach
+// to it by name; every rank owns one slot of `capacity` floats.
+class ShmCommunicator {
+  ShmCommunicator(ShmCommunicator const &) = delete;
+  ShmCommunicator &operator=(ShmCommunicator const &) = delete;
+
+  std::string name_;
+  int rank_;
+  int world_size_;
+  size_t capacity_;
+  size_t mapped_size_ = 0;
+  ShmHeader *header_ = nullptr;
+  float *slots_ = nullptr;
+  bool sense_ = false;
+
+  float *slot(int rank) { return slots_ + rank * capacity_; }
+
+public:
+  ShmCommunicator(std::string name, int rank, int world_size,
+                  size_t capacity);
+  ~ShmCommunicator();
+
+  // Reads AUTOGRAD_SHM_NAME, AUTOGRAD_RANK and AUTOGRAD_WORLD_SIZE as set up
+  // by the `autograd_launch` binary.
+  static std::unique_ptr<ShmCommunicator> from_env(size_t capacity);
+
+  int rank() const { return rank_; }
+  int world_size() const { return world_size_; }
+
+  void barrier();
+
+  // Ring all-reduce (sum). Every element is reduced in the same order on
+  // all ranks, so the results are bit-identical across ranks.
+  void all_reduce(float *data, size_t count);
+
+  void broadcast(float *data, size_t count, int root);
+};
+
+class DistributedDataParallel {
+  ShmCommunicator &comm_;
+  FlatParameters parameters_;
+
+public:
+  DistributedDataParallel(ShmCommunicator &comm, FlatParameters parameters);
+
+  std::vector<std::shared_ptr<Variable>> &parameters() {
+    return parameters_.parameters();
+  }
+
+  void broadcast_parameters(int root = 0);
+
+  // Replaces the local grads with their mean over all ranks.
+  void all_reduce_grads();
+};
+
+} // namespace autograd
+
+#endif // __DISTRIBUTED_H__
@@ -0,0 +1,133 @@
+#if !defined(__DTYPE_H__)
+#define __DTYPE_H__
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace autograd {
+
+// IEEE 754 binary16. Arithmetic is done in float through the implicit
+// conversion, only storage is 16 bits.
+struct half {
+  uint16_t bits = 0;
+
+  half() = default;
+  half(float value) : bits(from_float(value)) {}
+  operator float() const { return to_float(bits); }
+
+  half &operator+=(float value) { return *this = float(*this) + value; }
+  half &operator-=(float value) { return *this = float(*this) - value; }
+  half &operator*=(float value) { return *this = float(*this) * value; }
+  half &operator/=(float value) { return *this = float(*this) / value; }
+
+  static uint16_t from_float(float value) {
+    uint32_t x;
+    std::memcpy(&x, &value, sizeof(x));
+    uint16_t sign = (x >> 16) & 0x8000;
+    uint32_t abs = x & 0x7fffffff;
+    if (abs >= 0x7f800000) {
+      return sign | 0x7c00 | (abs > 0x7f800000 ? 0x0200 : 0);
+    }
+    if (abs >= 0x477ff000) {
+      return sign | 0x7c00;
+    }
+    if (abs < 0x38800000) {
+      float f;
+      std::memcpy(&f, &abs, sizeof(f));
+      return sign | (uint16_t)std::nearbyint(f * 16777216.0f);
+    }
+    uint32_t rebiased = abs - 0x38000000;
+    rebiased += 0x0fff + ((rebiased >> 13) & 1);
+    return sign | (rebiased >> 13);
+  }
+
+  static float to_float(uint16_t bits) {
+    uint32_t sign = (uint32_t)(bits & 0x8000) << 16;
+    uint32_t exponent = (bits >> 10) & 0x1f;
+    uint32_t mantissa = bits & 0x03ff;
+    uint32_t x;
+    if (exponent == 0) {
+      float f = std::ldexp((float)mantissa, -24);
+      std::memcpy(&x, &f, sizeof(x));
+      x |= sign;
+    } else if (exponent == 0x1f) {
+      x = sign | 0x7f800000 | (mantissa << 13);
+    } else {
+      x = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    float f;
+    std::memcpy(&f, &x, sizeof(f));
+    return f;
+  }
+};
+
+// Upper 16 bits of a float: same range as float, 8 bits of precision.
+struct bfloat16 {
+  uint16_t bits = 0;
+
+  bfloat16() = default;
+  bfloat16(float value) : bits(from_float(value)) {}
+  operator float() const { return to_float(bits); }
+
+  bfloat16 &operator+=(float value) { return *this = float(*this) + value; }
+  bfloat16 &operator-=(float value) { return *this = float(*this) - value; }
+  bfloat16 &operator*=(float value) { return *this = float(*this) * value; }
+  bfloat16 &operator/=(float value) { return *this = float(*this) / value; }
+
+  static uint16_t from_float(float value) {
+    uint32_t x;
+    std::memcpy(&x, &value, sizeof(x));
+    if ((x & 0x7fffffff) > 0x7f800000) {
+      return (x >> 16) | 0x0040;
+    }
+    x += 0x7fff + ((x >> 16) & 1);
+    return x >> 16;
+  }
+
+  static float to_float(uint16_t bits) {
+    uint32_t x = (uint32_t)bits << 16;
+    float f;
+    std::memcpy(&f, &x, sizeof(f));
+    return f;
+  }
+};
+
+// Type used for gradients and intermediate arithmetic of a storage type.
+template <typename T> struct accumulate_type { using type = T; };
+template <> struct accumulate_type<half> { using type = float; };
+template <> struct accumulate_type<bfloat16> { using type = float; };
+
+template <typename T> using acc_type = typename accumulate_type<T>::type;
+
+// Stable tags for the scalar types, used by the on-disk formats.
+enum class ScalarType : uint32_t {
+  Float32 = 0,
+  Float64 = 1,
+  Float16 = 2,
+  BFloat16 = 3,
+};
+
+template <typename T> struct scalar_type_of;
+template <> struct scalar_type_of<float> {
+  static constexpr ScalarType value = ScalarType::Float32;
+};
+template <> struct scalar_type_of<double> {
+  static constexpr ScalarType value = ScalarType::Float64;
+};
+template <> struct scalar_type_of<half> {
+  static constexpr ScalarType value = ScalarType::Float16;
+};
+template <> struct scalar_type_of<bfloat16> {
+  static constexpr ScalarType value = ScalarType::BFloat16;
+};
+
+#define AUTOGRAD_FORALL_SCALAR_TYPES(_)                                        \
+  _(float)                                                                     \
+  _(double)                                                                    \
+  _(half)                                                                      \
+  _(bfloat16)
+
+} // namespace autograd
+
+#endif // __DTYPE_H__
@@ -0,0 +1,174 @@
+#if !defined(__GRAPH_H__)
+#define __GRAPH_H__
+
+#include "autograd/kernels.h"
+#include "autograd/mapped_file.h"
+#include "autograd/variable.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace autograd {
+
+// Serialized compute graph (native byte order). Nodes are numbered in
+// topological order, every node only reads nodes with a smaller number:
+//
+//   GraphHeader                              at offset 0
+//   OpCode[num_nodes]                        opcodes
+//   uint32_t[num_nodes + 1], uint32_t[]      inputs of each node, CSR
+//   uint32_t[num_nodes + 1], uint32_t[]      saved forward values, CSR
+//   LeafBinding[num_leaves]                  leaves
+//
+// Every section starts on a kGraphAlignment boundary.
+constexpr char kGraphMagic[8] = {'A', 'G', 'G', 'R', 'A', 'P', 'H', 0};
+constexpr uint32_t kGraphVersion = 1;
+constexpr uint32_t kGraphAlignment = 64;
+
+struct GraphHeader {
+  char magic[8];
+  uint32_t version;
+  ScalarType dtype;
+  uint32_t num_nodes;
+  uint32_t num_edges;
+  uint32_t num_saved;
+  uint32_t num_leaves;
+  uint32_t root;
+  uint32_t reserved0;
+  uint64_t opcodes_offset;
+  uint64_t edge_offsets_offset;
+  uint64_t edges_offset;
+  uint64_t saved_offsets_offset;
+  uint64_t saved_offset;
+  uint64_t leaves_offset;
+  uint64_t file_size;
+  uint8_t reserved[32];
+};
+
+// A node that was not produced by a recorded operation: a parameter, an
+// input or a constant. `value` is used when nothing is bound to the leaf.
+struct LeafBinding {
+  uint32_t node;
+  uint32_t requires_grad;
+  double value;
+};
+
+static_assert(sizeof(GraphHeader) == 128, "");
+static_assert(sizeof(LeafBinding) == 16, "");
+
+// Non-owning view of a graph, either in memory or in a mapped file.
+struct GraphView {
+  ScalarType dtype = ScalarType::Float32;
+  uint32_t num_nodes = 0;
+  uint32_t num_leaves = 0;
+  uint32_t root = 0;
+  const OpCode *opcodes = nullptr;
+  const uint32_t *edge_offsets = nullptr;
+  const uint32_t *edges = nullptr;
+  const uint32_t *saved_offsets = nullptr;
+  const uint32_t *saved = nullptr;
+  const LeafBinding *leaves = nullptr;
+};
+
+class Graph {
+public:
+  ScalarType dtype_ = ScalarType::Float32;
+  uint32_t root_ = 0;
+  std::vector<OpCode> opcodes_;
+  std::vector<uint32_t> edge_offsets_;
+  std::vector<uint32_t> edges_;
+  std::vector<uint32_t> saved_offsets_;
+  std::vector<uint32_t> saved_;
+  std::vector<LeafBinding> leaves_;
+
+  GraphView view() const;
+
+  void save(const std::string &path) const;
+};
+
+class MappedGraph {
+  MappedFile file_;
+  GraphView view_;
+
+public:
+  explicit MappedGraph(const std::string &path);
+
+  const GraphView &view() const { return view_; }
+};
+
+// Records the operations executed on BasicVariable<T> by this thread while
+// it is alive. The backward graph is still built as usual.
+//
+//   GraphCapture<float> capture;
+//   auto loss = model.forward(x);
+//   Graph graph = capture.finish(loss, &leaves);
+template <typename T> class GraphCapture {
+  GraphCapture(GraphCapture const &) = delete;
+  GraphCapture &operator=(GraphCapture const &) = delete;
+
+  struct Record {
+    OpCode op;
+    uint32_t inputs[2];
+  };
+
+  static thread_local GraphCapture *current_;
+  GraphCapture *previous_ = nullptr;
+  bool active_ = true;
+  std::unordered_map<const BasicVariable<T> *, uint32_t> slots_;
+  // Keeps every recorded variable alive so that its address cannot be
+  // reused by a new variable during the capture.
+  std::vector<std::shared_ptr<BasicVariable<T>>> variables_;
+  std::vector<Record> records_;
+
+  uint32_t slot(const std::shared_ptr<BasicVariable<T>> &variable);
+  void stop();
+
+public:
+  GraphCapture();
+  ~GraphCapture();
+
+  static GraphCapture *current();
+
+  void record(OpCode op, const std::shared_ptr<BasicVariable<T>> &a,
+              const std::shared_ptr<BasicVariable<T>> &b,
+              const std::shared_ptr<BasicVariable<T>> &result);
+
+  // Stops recording and returns the part of the graph that `root` depends
+  // on. The variables behind the leaves are appended to `leaves` in leaf
+  // order, ready to be passed to GraphExecutor::bind.
+  Graph finish(const std::shared_ptr<BasicVariable<T>> &root,
+               std::vector<std::shared_ptr<BasicVariable<T>>> *leaves =
+                   nullptr);
+};
+
+// Runs a graph without the operator overloads: forward is a linear sweep over
+// the nodes, backward a reverse sweep over a flat gradient array.
+template <typename T> class GraphExecutor {
+  using A = acc_type<T>;
+
+  GraphView graph_;
+  std::vector<A> values_;
+  std::vector<A> grads_;
+  std::vector<std::shared_ptr<BasicVariable<T>>> bindings_;
+
+public:
+  explicit GraphExecutor(const GraphView &graph);
+
+  // Leaf `leaf` reads its value from, and accumulates its grad into,
+  // `variable`.
+  void bind(uint32_t leaf, std::shared_ptr<BasicVariable<T>> variable);
+  void bind(const std::vector<std::shared_ptr<BasicVariable<T>>> &leaves);
+
+  // Returns the value of the root.
+  A forward();
+
+  void backward(A grad = 1);
+
+  A value(uint32_t node) const { return values_[node]; }
+  A grad(uint32_t node) const { return grads_[node]; }
+};
+
+} // namespace autograd
+
+#endif // __GRAPH_H__
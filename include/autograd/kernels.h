@@ -0,0 +1,133 @@
+#if !defined(__KERNELS_H__)
+#define __KERNELS_H__
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace autograd {
+
+// Scalar operations understood by the graph format and the replay engine.
+// The numbering is part of the serialized format, append only. The opcodes
+// from AccumulateGrad on only tag backward nodes and never appear in a
+// serialized graph.
+enum class OpCode : uint8_t {
+  Leaf = 0,
+  Add = 1,
+  Sub = 2,
+  Mul = 3,
+  Div = 4,
+  Pow = 5,
+  Log = 6,
+  ReLU = 7,
+  Neg = 8,
+  AccumulateGrad = 9,
+  // A node defined outside of the library.
+  Custom = 10,
+};
+
+constexpr int kNumGraphOpCodes = 9;
+constexpr int kNumOpCodes = 11;
+
+inline const char *opcode_name(OpCode op) {
+  static const char *names[kNumOpCodes] = {
+      "Leaf", "Add", "Sub", "Mul", "Div", "Pow",
+      "Log", "ReLU", "Neg", "AccumulateGrad", "Custom",
+  };
+  return (int)op < kNumOpCodes ? names[(int)op] : "Unknown";
+}
+
+inline int opcode_arity(OpCode op) {
+  switch (op) {
+  case OpCode::Leaf:
+  case OpCode::AccumulateGrad:
+  case OpCode::Custom:
+    return 0;
+  case OpCode::Log:
+  case OpCode::ReLU:
+  case OpCode::Neg:
+    return 1;
+  default:
+    return 2;
+  }
+}
+
+// Whether the backward of `op` reads the forward values of its inputs.
+inline bool opcode_saves_inputs(OpCode op) {
+  switch (op) {
+  case OpCode::Mul:
+  case OpCode::Div:
+  case OpCode::Pow:
+  case OpCode::Log:
+  case OpCode::ReLU:
+    return true;
+  default:
+    return false;
+  }
+}
+
+template <typename A> inline A forward_kernel(OpCode op, A a, A b) {
+  switch (op) {
+  case OpCode::Add:
+    return a + b;
+  case OpCode::Sub:
+    return a - b;
+  case OpCode::Mul:
+    return a * b;
+  case OpCode::Div:
+    return a / b;
+  case OpCode::Pow:
+    return std::pow(a, b);
+  case OpCode::Log:
+    return std::log(a);
+  case OpCode::ReLU:
+    return std::max(a, A(0));
+  case OpCode::Neg:
+    return -a;
+  default:
+    return a;
+  }
+}
+
+// Gradients of `op` w.r.t. its inputs `a` and `b` given the output gradient.
+template <typename A>
+inline void backward_kernel(OpCode op, A a, A b, A grad, A &grad_a,
+                            A &grad_b) {
+  switch (op) {
+  case OpCode::Add:
+    grad_a = grad;
+    grad_b = grad;
+    break;
+  case OpCode::Sub:
+    grad_a = grad;
+    grad_b = -grad;
+    break;
+  case OpCode::Mul:
+    grad_a = b * grad;
+    grad_b = a * grad;
+    break;
+  case OpCode::Div:
+    grad_a = A(1) / b * grad;
+    grad_b = -a / (b * b) * grad;
+    break;
+  case OpCode::Pow:
+    grad_a = grad * b * std::pow(a, b - 1);
+    grad_b = grad * std::pow(a, b) * std::log(a);
+    break;
+  case OpCode::Log:
+    grad_a = grad / a;
+    break;
+  case OpCode::ReLU:
+    grad_a = a >= 0 ? grad : A(0);
+    break;
+  case OpCode::Neg:
+    grad_a = -grad;
+    break;
+  default:
+    break;
+  }
+}
+
+} // namespace autograd
+
+#endif // __KERNELS_H__
@@ -0,0 +1,28 @@
+#if !defined(__MAPPED_FILE_H__)
+#define __MAPPED_FILE_H__
+
+#include <cstddef>
+#include <string>
+
+namespace autograd {
+
+// Read-only, private mapping of a whole file. Pages are faulted in on first
+// access, nothing is read up front.
+class MappedFile {
+  MappedFile(MappedFile const &) = delete;
+  MappedFile &operator=(MappedFile const &) = delete;
+
+  const char *data_ = nullptr;
+  size_t size_ = 0;
+
+public:
+  explicit MappedFile(const std::string &path);
+  ~MappedFile();
+
+  const char *data() const { return data_; }
+  size_t size() const { return size_; }
+};
+
+} // namespace autograd
+
+#endif // __MAPPED_FILE_H__
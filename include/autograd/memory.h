@@ -0,0 +1,46 @@
+#if !defined(__MEMORY_H__)
+#define __MEMORY_H__
+
+#include "autograd/kernels.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace autograd {
+
+// Objects of one kind that are currently alive, and the most that were alive
+// at once since the start of the process or the last reset_peak_memory_stats.
+// Bytes are the sizes of the objects themselves, without the shared_ptr
+// control blocks and allocator overhead.
+struct LiveStats {
+  int64_t count = 0;
+  int64_t bytes = 0;
+  int64_t peak_count = 0;
+  int64_t peak_bytes = 0;
+};
+
+struct MemoryStats {
+  LiveStats nodes;
+  // Backward nodes by the opcode of the operator that created them. Custom
+  // nodes are counted as sizeof(BasicNode<T>).
+  LiveStats nodes_by_op[kNumOpCodes];
+  // Includes the gradient buffers of the backward pass.
+  LiveStats variables;
+  // Edges between backward nodes.
+  LiveStats edges;
+};
+
+// A few relaxed atomic loads, cheap enough to call from a metrics exporter
+// while other threads are training. Threads publish their changes in small
+// batches, the counts of other threads can lag behind by a few dozen objects.
+MemoryStats memory_stats();
+
+void reset_peak_memory_stats();
+
+// Called by the constructors and destructors of Node and BasicVariable.
+void track_node(OpCode op, int64_t bytes, int64_t count);
+void track_variables(int64_t bytes, int64_t count);
+void track_edges(int64_t count);
+
+} // namespace autograd
+
+#endif // __MEMORY_H__
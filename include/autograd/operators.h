@@ -5,58 +5,79 @@
 
 namespace autograd {
 
-class AddBackward : public Node {
+template <typename T> class AddBackward : public BasicNode<T> {
 public:
-  variable_list apply(variable_list &&grads) override;
+  AddBackward() : BasicNode<T>(OpCode::Add, sizeof(AddBackward)) {}
+  variable_list<T> apply(variable_list<T> &&grads) override;
 };
 
-class SubBackward : public Node {
+template <typename T> class SubBackward : public BasicNode<T> {
 public:
-  variable_list apply(variable_list &&grads) override;
+  SubBackward() : BasicNode<T>(OpCode::Sub, sizeof(SubBackward)) {}
+  variable_list<T> apply(variable_list<T> &&grads) override;
 };
 
-class AccumulateGrad : public Node {
+template <typename T> class AccumulateGrad : public BasicNode<T> {
 public:
-  variable_list apply(variable_list &&grads) override;
-  std::weak_ptr<Variable> variable_;
+  AccumulateGrad()
+      : BasicNode<T>(OpCode::AccumulateGrad, sizeof(AccumulateGrad)) {}
+  variable_list<T> apply(variable_list<T> &&grads) override;
+  std::weak_ptr<BasicVariable<T>> variable_;
 };
 
-class MulBackward : public Node {
+template <typename T> class MulBackward : public BasicNode<T> {
 public:
-  variable_list apply(variable_list &&grads) override;
-  std::shared_ptr<Variable> other_;
-  std::shared_ptr<Variable> self_;
+  MulBackward() : BasicNode<T>(OpCode::Mul, sizeof(MulBackward)) {}
+  size_t saved_bytes() const override {
+    return 2 * sizeof(BasicVariable<T>);
+  }
+  variable_list<T> apply(variable_list<T> &&grads) override;
+  std::shared_ptr<BasicVariable<T>> other_;
+  std::shared_ptr<BasicVariable<T>> self_;
 };
 
-class DivBackward : public Node {
+template <typename T> class DivBackward : public BasicNode<T> {
 public:
-  variable_list apply(variable_list &&grads) override;
-  std::shared_ptr<Variable> other_;
-  std::shared_ptr<Variable> self_;
+  DivBackward() : BasicNode<T>(OpCode::Div, sizeof(DivBackward)) {}
+  size_t saved_bytes() const override {
+    return 2 * sizeof(BasicVariable<T>);
+  }
+  variable_list<T> apply(variable_list<T> &&grads) override;
+  std::shared_ptr<BasicVariable<T>> other_;
+  std::shared_ptr<BasicVariable<T>> self_;
 };
 
-class PowBackward : public Node {
+template <typename T> class PowBackward : public BasicNode<T> {
 public:
-  variable_list apply(variable_list &&grads) override;
-  std::shared_ptr<Variable> other_;
-  std::shared_ptr<Variable> self_;
+  PowBackward() : BasicNode<T>(OpCode::Pow, sizeof(PowBackward)) {}
+  size_t saved_bytes() const override {
+    return 2 * sizeof(BasicVariable<T>);
+  }
+  variable_list<T> apply(variable_list<T> &&grads) override;
+  std::shared_ptr<BasicVariable<T>> other_;
+  std::shared_ptr<BasicVariable<T>> self_;
 };
 
-class LogBackward : public Node {
+template <typename T> class LogBackward : public BasicNode<T> {
 public:
-  variable_list apply(variable_list &&grads) override;
-  std::shared_ptr<Variable> self_;
+  LogBackward() : BasicNode<T>(OpCode::Log, sizeof(LogBackward)) {}
+  size_t saved_bytes() const override { return sizeof(BasicVariable<T>); }
+  variable_list<T> apply(variable_list<T> &&grads) override;
+  std::shared_ptr<BasicVariable<T>> self_;
 };
 
-class ReLUBackward : public Node {
+template <typename T> class ReLUBackward : public BasicNode<T> {
 public:
-  variable_list apply(variable_list &&grads) override;
-  std::shared_ptr<Variable> self_;
+  ReLUBackward() : BasicNode<T>(OpCode::ReLU, sizeof(ReLUBackward)) {}
+  size_t saved_bytes() const override { return sizeof(BasicVariable<T>); }
+  variable_list<T> apply(variable_list<T> &&grads) override;
+  std::shared_ptr<BasicVariable<T>> self_;
 };
 
-class NegBackward : public Node {
+template <typename T> class NegBackward : public BasicNode<T> {
 public:
-  variable_list apply(variable_list &&grads) override;
+  NegBackward() : BasicNode<T>(OpCode::Neg, sizeof(NegBackward)) {}
+  variable_list<T> apply(variable_list<T> &&grads) override;
 };
 
 } // namespace autograd
@@ -1,6 +1,9 @@
 #if !defined(__OPTIMIZER_H__)
 #define __OPTIMIZER_H__
 
+#include <cmath>
+#include <vector>
+
 template <class... Variables> void zero_grad() { return; }
 
 template <class T, class... Variables>
@@ -16,6 +19,12 @@ void zero_grad(T (&variables)[N]) {
     }
 }
 
+template <class T> void zero_grad(std::vector<T> &variables) {
+  for (auto &variable : variables) {
+    variable->grad_ = 0.0f;
+  }
+}
+
 class SGD {
 public:
   float learning_rate_ = 0.003;
@@ -34,6 +43,76 @@ public:
           variables[i]->value_ -= learning_rate_ * variables[i]->grad_;
       }
   }
+
+  template <class T> void step(std::vector<T> &variables) {
+    for (auto &variable : variables) {
+      variable->value_ -= learning_rate_ * variable->grad_;
+    }
+  }
+};
+
+// Dynamic loss scaling for half and bfloat16 variables: backpropagate from
+// `scale_` instead of 1 so that small gradients do not flush to zero, then
+// unscale them before the update and skip the steps that overflowed.
+//
+//   autograd::run_backward(*loss, scaler.scale_);
+//   scaler.step(sgd, model.layer1, model.layer2);
+class GradScaler {
+  template <class T> bool unscale_one(T &variable) {
+    variable->grad_ /= scale_;
+    return std::isfinite(variable->grad_);
+  }
+
+  template <class T, size_t N> bool unscale_one(T (&variables)[N]) {
+    bool finite = true;
+    for (size_t i = 0; i < N; ++i) {
+      finite = unscale_one(variables[i]) && finite;
+    }
+    return finite;
+  }
+
+  template <class T> bool unscale_one(std::vector<T> &variables) {
+    bool finite = true;
+    for (auto &variable : variables) {
+      finite = unscale_one(variable) && finite;
+    }
+    return finite;
+  }
+
+public:
+  float scale_ = 65536.0f;
+  float growth_factor_ = 2.0f;
+  float backoff_factor_ = 0.5f;
+  int growth_interval_ = 2000;
+  int growth_tracker_ = 0;
+
+  // Divides the grads by the current scale, returns false if any of them is
+  // inf or nan.
+  template <class... Variables> bool unscale(Variables &... variables) {
+    bool finite = true;
+    ((finite = unscale_one(variables) && finite), ...);
+    return finite;
+  }
+
+  void update(bool finite) {
+    if (!finite) {
+      scale_ *= backoff_factor_;
+      growth_tracker_ = 0;
+    } else if (++growth_tracker_ == growth_interval_) {
+      scale_ *= growth_factor_;
+      growth_tracker_ = 0;
+    }
+  }
+
+  template <class... Variables>
+  bool step(SGD &sgd, Variables &... variables) {
+    bool finite = unscale(variables...);
+    if (finite) {
+      (sgd.step(variables), ...);
+    }
+    update(finite);
+    return finite;
+  }
 };
 
 #endif // __OPTIMIZER_H__
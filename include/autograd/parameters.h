@@ -0,0 +1,48 @@
+#if !defined(__PARAMETERS_H__)
+#define __PARAMETERS_H__
+
+#include "autograd/variable.h"
+#include <memory>
+#include <vector>
+
+namespace autograd {
+
+// Contiguous mirror of the values and grads of a set of leaf variables, so
+// that they can be moved around (all-reduced, saved, ...) as a single buffer.
+// Every variable keeps its own value and grad, so the buffer is a copy that
+// has to be gathered before and scattered after each collective.
+class FlatParameters {
+  std::vector<std::shared_ptr<Variable>> parameters_;
+  std::vector<float> values_;
+  std::vector<float> grads_;
+
+public:
+  FlatParameters() = default;
+
+  FlatParameters(std::vector<std::shared_ptr<Variable>> parameters);
+
+  void add(std::shared_ptr<Variable> parameter);
+
+  template <size_t N> void add(std::shared_ptr<Variable> (&parameters)[N]) {
+    for (size_t i = 0; i < N; ++i) {
+      add(parameters[i]);
+    }
+  }
+
+  size_t size() const { return parameters_.size(); }
+
+  std::vector<std::shared_ptr<Variable>> &parameters() { return parameters_; }
+
+  float *values() { return values_.data(); }
+
+  float *grads() { return grads_.data(); }
+
+  void gather_values();
+  void scatter_values();
+  void gather_grads();
+  void scatter_grads();
+};
+
+} // namespace autograd
+
+#endif // __PARAMETERS_H__
@@ -0,0 +1,108 @@
+#if !defined(__TAPE_H__)
+#define __TAPE_H__
+
+#include "autograd/kernels.h"
+#include "autograd/variable.h"
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace autograd {
+
+// A Wengert list. While a tape is alive, the operators on BasicVariable<T>
+// executed by this thread append a record to it instead of building the
+// backward graph, and run_backward on a variable produced on the tape is a
+// single reverse sweep over the records with the gradients in a flat array.
+//
+//   Tape<float> tape;
+//   for (...) {
+//     auto loss = model.forward(x);
+//     run_backward(*loss);
+//     sgd.step(...);
+//     tape.clear();
+//   }
+//
+// Variables produced on a tape have no grad_fn, they are leaves for the graph
+// engine, and run_backward on one throws once its tape is stopped or cleared.
+// Inputs are read when they are first used on the tape: until the tape is
+// cleared, assigning a new value to a variable that is already on it changes
+// neither the results of later operators nor the gradients.
+//
+// Tapes nest. Operators are recorded on the innermost tape, and
+// run_backward goes to the tape that produced the root.
+template <typename T> class Tape {
+  Tape(Tape const &) = delete;
+  Tape &operator=(Tape const &) = delete;
+
+public:
+  using grad_type = acc_type<T>;
+
+  static constexpr uint32_t kNoSlot = UINT32_MAX;
+
+  struct Record {
+    OpCode op;
+    uint32_t inputs[2];
+    uint32_t output;
+  };
+
+private:
+  static thread_local Tape *current_;
+  Tape *previous_ = nullptr;
+  bool active_ = true;
+  uint32_t id_;
+  std::vector<Record> records_;
+  // Forward value of every slot, as read by the backward kernels.
+  std::vector<grad_type> values_;
+  std::vector<grad_type> adjoints_;
+  // Variables that were used on the tape without being produced by it, with
+  // their slots.
+  std::vector<std::pair<uint32_t, std::shared_ptr<BasicVariable<T>>>> leaves_;
+  // Slots of the inputs whose tape_id_ belongs to an enclosing tape, which
+  // still needs it.
+  std::unordered_map<const BasicVariable<T> *, uint32_t> foreign_slots_;
+
+  static Tape *find(uint32_t id);
+  uint32_t slot(const std::shared_ptr<BasicVariable<T>> &variable);
+
+public:
+  Tape();
+  ~Tape();
+
+  static Tape *current();
+
+  // The active tape of this thread that produced or first read `variable`,
+  // null if there is none.
+  static Tape *owner(const BasicVariable<T> &variable) {
+    return variable.tape_id_ ? find(variable.tape_id_) : nullptr;
+  }
+
+  // Computes `op` on `a` (and `b` for binary operators) and appends it.
+  std::shared_ptr<BasicVariable<T>>
+  record(OpCode op, const std::shared_ptr<BasicVariable<T>> &a,
+         const std::shared_ptr<BasicVariable<T>> &b);
+
+  bool contains(const BasicVariable<T> &variable) const {
+    return variable.tape_id_ == id_;
+  }
+
+  // Accumulates the gradients of `root` into the leaves that require grad.
+  void backward(const BasicVariable<T> &root, grad_type grad = 1);
+
+  // Forgets all records, keeping the memory for the next iteration.
+  void clear();
+
+  // Stops recording. Stopping a tape that encloses another one removes it
+  // from the nesting, the inner tape stays current and hands over to the
+  // tape this one was started in.
+  void stop();
+
+  const std::vector<Record> &records() const { return records_; }
+
+  size_t num_slots() const { return values_.size(); }
+};
+
+} // namespace autograd
+
+#endif // __TAPE_H__
@@ -1,7 +1,10 @@
 #if !defined(__TENSOR_H__)
 #define __TENSOR_H__
 
+#include "autograd/dtype.h"
+#include "autograd/memory.h"
 #include <boost/log/trivial.hpp>
+#include <cstdint>
 #include <fmt/format.h>
 #include <memory>
 
@@ -18,43 +21,70 @@ public:
   Edge(std::shared_ptr<Node> grad_fn, int input_nr)
       : grad_fn_(grad_fn), input_nr_(input_nr) {}
 
-  std::shared_ptr<Node> grad_fn() { return grad_fn_; }
+  const std::shared_ptr<Node> &grad_fn() const { return grad_fn_; }
 
-  int input_nr() { return input_nr_; }
+  int input_nr() const { return input_nr_; }
 
   void set_grad_fn(std::shared_ptr<Node> grad_fn) { grad_fn_ = grad_fn; }
 };
 
-class Variable : public std::enable_shared_from_this<Variable> {
-  using T = float;
+template <typename T> class BasicVariable;
 
+// Keeps the variable counters of memory_stats() up to date.
+template <typename T> struct VariableAccount {
+  VariableAccount() { track_variables(sizeof(BasicVariable<T>), 1); }
+  VariableAccount(const VariableAccount &) : VariableAccount() {}
+  VariableAccount &operator=(const VariableAccount &) { return *this; }
+  ~VariableAccount() { track_variables(sizeof(BasicVariable<T>), -1); }
+};
+
+// T is the storage type of the value. Gradients are kept in acc_type<T>, so a
+// half or bfloat16 variable still accumulates its grad in float.
+// VariableAccount is an empty base, so it takes no space.
+template <typename T>
+class BasicVariable : public std::enable_shared_from_this<BasicVariable<T>>,
+                      private VariableAccount<T> {
   // Autograd Metadata
   bool requires_grad_ = true;
 
 public:
+  using value_type = T;
+  using grad_type = acc_type<T>;
+
+  // Produced by a tape rather than only read by one, see Tape. Declared
+  // here to fill the padding after requires_grad_.
+  bool tape_output_ = false;
   T value_ = T();
-  T grad_ = T();
+  grad_type grad_ = grad_type();
   Edge gradient_edge_;
+  // Slot of the variable on the tape with id `tape_id_`, see Tape.
+  uint32_t tape_id_ = 0;
+  uint32_t tape_slot_ = 0;
 
   void set_gradient_edge(Edge &&gradient_edge);
 
   Edge gradient_edge();
 
-  void add_grad(T grad_value) { grad_ += grad_value; }
+  void add_grad(grad_type grad_value) { grad_ += grad_value; }
 
-  std::shared_ptr<Variable> shared_ptr() { return shared_from_this(); }
+  std::shared_ptr<BasicVariable> shared_ptr() {
+    return this->shared_from_this();
+  }
 
-  Variable() = default;
+  BasicVariable() = default;
 
-  Variable(T value) : value_(value) {}
+  BasicVariable(grad_type value) : value_(value) {}
 
-  Variable operator=(T value) { value_ = value; }
+  BasicVariable &operator=(grad_type value) {
+    value_ = value;
+    return *this;
+  }
+
+  grad_type grad() { return grad_; }
 
-  T grad() { return grad_; }
-  
   T value() { return value_; }
 
-  void zero_grad() { grad_ = 0.0f; }
+  void zero_grad() { grad_ = grad_type(); }
 
   bool requires_grad() { return requires_grad_; }
 
@@ -62,28 +92,49 @@ public:
 
   std::string to_string() const {
     return fmt::format("Variable @ {} value = {} grad = {}", fmt::ptr(this),
-                       value_, grad_);
+                       static_cast<grad_type>(value_), grad_);
   }
 
-  std::shared_ptr<Variable> detach();
-  std::shared_ptr<Variable> log();
-  std::shared_ptr<Variable> relu();
-  std::shared_ptr<Variable> sigmoid();
+  std::shared_ptr<BasicVariable> detach();
+  std::shared_ptr<BasicVariable> log();
+  std::shared_ptr<BasicVariable> relu();
+  std::shared_ptr<BasicVariable> sigmoid();
 };
 
+using Variable = BasicVariable<float>;
+using DoubleVariable = BasicVariable<double>;
+using HalfVariable = BasicVariable<half>;
+using BFloat16Variable = BasicVariable<bfloat16>;
+
 std::shared_ptr<Variable> variable(float v);
 
-std::shared_ptr<Variable> operator+(std::shared_ptr<Variable> lhs,
-                                    std::shared_ptr<Variable> rhs);
-std::shared_ptr<Variable> operator-(std::shared_ptr<Variable> var);
-std::shared_ptr<Variable> operator-(std::shared_ptr<Variable> lhs,
-                                    std::shared_ptr<Variable> rhs);
-std::shared_ptr<Variable> operator*(std::shared_ptr<Variable> lhs,
-                                    std::shared_ptr<Variable> rhs);
-std::shared_ptr<Variable> operator/(std::shared_ptr<Variable> lhs,
-                                    std::shared_ptr<Variable> rhs);
-std::shared_ptr<Variable> operator^(std::shared_ptr<Variable> lhs,
-                                    std::shared_ptr<Variable> rhs);
+// variable<double>(v), variable<half>(v), ...
+template <typename T>
+std::shared_ptr<BasicVariable<T>> variable(acc_type<T> v);
+
+template <typename T>
+std::shared_ptr<BasicVariable<T>>
+operator+(std::shared_ptr<BasicVariable<T>> lhs,
+          std::shared_ptr<BasicVariable<T>> rhs);
+template <typename T>
+std::shared_ptr<BasicVariable<T>>
+operator-(std::shared_ptr<BasicVariable<T>> var);
+template <typename T>
+std::shared_ptr<BasicVariable<T>>
+operator-(std::shared_ptr<BasicVariable<T>> lhs,
+          std::shared_ptr<BasicVariable<T>> rhs);
+template <typename T>
+std::shared_ptr<BasicVariable<T>>
+operator*(std::shared_ptr<BasicVariable<T>> lhs,
+          std::shared_ptr<BasicVariable<T>> rhs);
+template <typename T>
+std::shared_ptr<BasicVariable<T>>
+operator/(std::shared_ptr<BasicVariable<T>> lhs,
+          std::shared_ptr<BasicVariable<T>> rhs);
+template <typename T>
+std::shared_ptr<BasicVariable<T>>
+operator^(std::shared_ptr<BasicVariable<T>> lhs,
+          std::shared_ptr<BasicVariable<T>> rhs);
 
 } // namespace autograd
 
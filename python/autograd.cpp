@@ -1,3 +1,4 @@
+#include <autograd/array.h>
 #include <autograd/autograd.h>
 #include <autograd/variable.h>
 #include <pybind11/operators.h>
@@ -5,18 +6,79 @@
 
 namespace py = pybind11;
 
+namespace {
+
+using VariablePtr = std::shared_ptr<autograd::Variable>;
+using autograd::VariableArray;
+using release_gil = py::call_guard<py::gil_scoped_release>;
+
+// A strided float view into memory kept alive by `owner`, exported through
+// the buffer protocol so that memoryview() and numpy.asarray() do not copy.
+struct BufferView {
+  std::shared_ptr<const void> owner;
+  void *data;
+  ssize_t size;
+  ssize_t stride;
+  bool readonly;
+};
+
+// Arrays that are not one block (results of operations) are copied.
+template <class Get>
+BufferView make_view(VariableArray &array, void *data, Get get) {
+  if (array.contiguous()) {
+    return {array.block(), data, (ssize_t)array.size(),
+            (ssize_t)VariableArray::stride(), false};
+  }
+  auto copy = std::make_shared<std::vector<float>>(array.size());
+  for (size_t i = 0; i < array.size(); ++i) {
+    (*copy)[i] = get(*array[i]);
+  }
+  return {copy, copy->data(), (ssize_t)copy->size(), sizeof(float), true};
+}
+
+VariableArray array_from_buffer(py::buffer buffer, bool requires_grad) {
+  py::buffer_info info = buffer.request();
+  if (info.ndim != 1) {
+    throw std::invalid_argument("Expected a one-dimensional buffer");
+  }
+  auto base = static_cast<const char *>(info.ptr);
+  std::vector<float> values(info.shape[0]);
+  if (info.format == py::format_descriptor<float>::format()) {
+    for (ssize_t i = 0; i < info.shape[0]; ++i) {
+      values[i] = *reinterpret_cast<const float *>(base + i * info.strides[0]);
+    }
+  } else if (info.format == py::format_descriptor<double>::format()) {
+    for (ssize_t i = 0; i < info.shape[0]; ++i) {
+      values[i] = *reinterpret_cast<const double *>(base + i * info.strides[0]);
+    }
+  } else {
+    throw py::type_error("Expected a float32 or float64 buffer, got format " +
+                         info.format);
+  }
+  VariableArray array(values.data(), values.size());
+  array.set_requires_grad(requires_grad);
+  return array;
+}
+
+} // namespace
+
 PYBIND11_MODULE(autograd_py, m) {
   m.doc() = R"pbdoc(
         Autograd Library in Python
+
+        backward, print_graph and the array operations release the GIL.
+        Graphs can be built and differentiated on several threads at once
+        only if they share no variables: backward on graphs with common
+        parameters from two threads races on their grads.
     )pbdoc";
 
   py::class_<autograd::Variable, std::shared_ptr<autograd::Variable>>(
       m, "Variable")
-      .def("__add__", autograd::operator+, py::is_operator())
-      .def("__radd__", autograd::operator+, py::is_operator())
-      .def("__mul__", autograd::operator*, py::is_operator())
-      .def("__rmul__", autograd::operator*, py::is_operator())
-      .def("__truediv__", autograd::operator/, py::is_operator())
+      .def("__add__", &autograd::operator+<float>, py::is_operator())
+      .def("__radd__", &autograd::operator+<float>, py::is_operator())
+      .def("__mul__", &autograd::operator*<float>, py::is_operator())
+      .def("__rmul__", &autograd::operator*<float>, py::is_operator())
+      .def("__truediv__", &autograd::operator/<float>, py::is_operator())
       .def("__sub__",
            static_cast<std::shared_ptr<autograd::Variable> (*)(
                std::shared_ptr<autograd::Variable>,
@@ -31,11 +93,13 @@ PYBIND11_MODULE(autograd_py, m) {
            static_cast<std::shared_ptr<autograd::Variable> (*)(
                std::shared_ptr<autograd::Variable>)>(&autograd::operator-),
            py::is_operator())
-      .def("__pow__", autograd::operator^, py::is_operator())
-      .def("backward",
-           [](std::shared_ptr<autograd::Variable> root) {
-             autograd::run_backward(*root);
-           })
+      .def("__pow__", &autograd::operator^<float>, py::is_operator())
+      .def(
+          "backward",
+          [](std::shared_ptr<autograd::Variable> root) {
+            autograd::run_backward(*root);
+          },
+          release_gil())
       .def("detach", &autograd::Variable::detach)
       .def("log", &autograd::Variable::log)
       .def("relu", &autograd::Variable::relu)
@@ -43,19 +107,101 @@ PYBIND11_MODULE(autograd_py, m) {
       .def("zero_grad", &autograd::Variable::zero_grad)
       .def("grad", &autograd::Variable::grad)
       .def("value", &autograd::Variable::value)
+      .def("requires_grad", &autograd::Variable::requires_grad)
+      .def("set_requires_grad", &autograd::Variable::set_requires_grad)
       .def("__repr__", &autograd::Variable::to_string);
 
-  m.def("variable", &autograd::variable, R"pbdoc(
+  py::class_<BufferView>(m, "BufferView", py::buffer_protocol())
+      .def_buffer([](BufferView &view) {
+        return py::buffer_info(view.data, sizeof(float),
+                               py::format_descriptor<float>::format(), 1,
+                               {view.size}, {view.stride}, view.readonly);
+      });
+
+  py::class_<VariableArray>(m, "VariableArray")
+      .def("__len__", &VariableArray::size)
+      .def("__getitem__",
+           [](const VariableArray &array, ssize_t i) {
+             if (i < 0) {
+               i += array.size();
+             }
+             if (i < 0 || (size_t)i >= array.size()) {
+               throw py::index_error();
+             }
+             return array[i];
+           })
+      .def_property_readonly(
+          "values",
+          [](VariableArray &array) {
+            return make_view(array, array.values(),
+                             [](autograd::Variable &v) { return v.value_; });
+          },
+          R"pbdoc(
+        Buffer with the values. Writable and shared with the variables when
+        the array was created from values, a read-only copy otherwise.
+    )pbdoc")
+      .def_property_readonly(
+          "grads",
+          [](VariableArray &array) {
+            return make_view(array, array.grads(),
+                             [](autograd::Variable &v) { return v.grad_; });
+          })
+      .def("contiguous", &VariableArray::contiguous)
+      .def("zero_grad", &VariableArray::zero_grad)
+      .def("set_requires_grad", &VariableArray::set_requires_grad)
+      .def("sum", &VariableArray::sum, release_gil())
+      .def("log", &VariableArray::log, release_gil())
+      .def("relu", &VariableArray::relu, release_gil())
+      .def("sigmoid", &VariableArray::sigmoid, release_gil())
+      .def(
+          "__neg__", [](const VariableArray &a) { return -a; },
+          py::is_operator(), release_gil())
+#define DEF_ARRAY_OPERATOR(name, op)                                           \
+  .def(                                                                        \
+      name,                                                                    \
+      [](const VariableArray &a, const VariableArray &b) { return a op b; },   \
+      py::is_operator(), release_gil())                                        \
+      .def(                                                                    \
+          name,                                                                \
+          [](const VariableArray &a, const VariablePtr &b) { return a op b; }, \
+          py::is_operator(), release_gil())
+      DEF_ARRAY_OPERATOR("__add__", +)
+      DEF_ARRAY_OPERATOR("__sub__", -)
+      DEF_ARRAY_OPERATOR("__mul__", *)
+      DEF_ARRAY_OPERATOR("__truediv__", /)
+#undef DEF_ARRAY_OPERATOR
+      .def(
+          "__radd__",
+          [](const VariableArray &a, const VariablePtr &b) { return a + b; },
+          py::is_operator(), release_gil())
+      .def(
+          "__rmul__",
+          [](const VariableArray &a, const VariablePtr &b) { return a * b; },
+          py::is_operator(), release_gil());
+
+  m.def("variable",
+        static_cast<std::shared_ptr<autograd::Variable> (*)(float)>(
+            &autograd::variable),
+        R"pbdoc(
         Create an autograd variable.
     )pbdoc");
 
-  m.def("print_graph", [](std::shared_ptr<autograd::Variable> root) {
-    autograd::print_graph(*root);
-  });
+  m.def("array", &array_from_buffer, py::arg("values"),
+        py::arg("requires_grad") = true, R"pbdoc(
+        Create a VariableArray from a one-dimensional float32 or float64
+        buffer, e.g. a numpy array.
+    )pbdoc");
+
+  m.def(
+      "print_graph",
+      [](std::shared_ptr<autograd::Variable> root) {
+        autograd::print_graph(*root);
+      },
+      release_gil());
 
 #ifdef VERSION_INFO
   m.attr("__version__") = VERSION_INFO;
 #else
   m.attr("__version__") = "dev";
 #endif
-}
\ No newline at end of file
+}
@@ -1,5 +1,7 @@
 import unittest
-from autograd_py import variable
+from array import array as buffer
+
+from autograd_py import array, variable
 
 
 class VariableBackward(unittest.TestCase):
@@ -23,5 +25,28 @@ class VariableBackward(unittest.TestCase):
         self.assertAlmostEqual(x.grad(), 39)
 
 
+class VariableArrayBuffer(unittest.TestCase):
+
+    def test_values_are_shared(self):
+        x = array(buffer('f', [1.0, 2.0, 3.0]))
+        values = memoryview(x.values)
+        self.assertEqual(values.tolist(), [1.0, 2.0, 3.0])
+        values[1] = 5.0
+        self.assertAlmostEqual(x[1].value(), 5.0)
+
+    def test_grads_after_backward(self):
+        x = array(buffer('d', [1.0, 2.0, 3.0]))
+        loss = (x * x).sum()
+        loss.backward()
+        self.assertEqual(memoryview(x.grads).tolist(), [2.0, 4.0, 6.0])
+
+    def test_results_are_copied(self):
+        x = array(buffer('f', [1.0, 2.0]))
+        y = x + variable(1.0)
+        self.assertFalse(y.contiguous())
+        self.assertTrue(memoryview(y.values).readonly)
+        self.assertEqual(memoryview(y.values).tolist(), [2.0, 3.0])
+
+
 if __name__ == "__main__":
     unittest.main()
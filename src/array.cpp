@@ -0,0 +1,143 @@
+#include "autograd/array.h"
+
+#include <fmt/format.h>
+#include <stdexcept>
+
+namespace autograd {
+
+template <typename T>
+BasicVariableArray<T>::BasicVariableArray(const grad_type *values,
+                                          size_t size) {
+  if (size == 0) {
+    return;
+  }
+  block_.reset(new BasicVariable<T>[size]);
+  variables_.reserve(size);
+  for (size_t i = 0; i < size; ++i) {
+    block_[i].value_ = values[i];
+    // Every handle shares ownership of the whole block. Going through the
+    // raw pointer constructor (instead of aliasing) is what makes
+    // shared_from_this work on the elements. The deleter has to let go of
+    // the block when it is called: it is only destroyed with the control
+    // block, which the weak_this of the element keeps alive.
+    variables_.emplace_back(&block_[i],
+                            [block = block_](BasicVariable<T> *) mutable {
+                              block.reset();
+                            });
+  }
+}
+
+template <typename T>
+void BasicVariableArray<T>::set_requires_grad(bool requires_grad) {
+  for (auto &variable : variables_) {
+    variable->set_requires_grad(requires_grad);
+  }
+}
+
+template <typename T> void BasicVariableArray<T>::zero_grad() {
+  for (auto &variable : variables_) {
+    variable->zero_grad();
+  }
+}
+
+template <typename T, typename F>
+static BasicVariableArray<T> map(const BasicVariableArray<T> &array, F &&f) {
+  std::vector<std::shared_ptr<BasicVariable<T>>> result;
+  result.reserve(array.size());
+  for (auto &variable : array.variables()) {
+    result.push_back(f(variable));
+  }
+  return BasicVariableArray<T>(std::move(result));
+}
+
+template <typename T, typename F>
+static BasicVariableArray<T> zip(const BasicVariableArray<T> &lhs,
+                                 const BasicVariableArray<T> &rhs, F &&f) {
+  if (lhs.size() != rhs.size()) {
+    throw std::invalid_argument(fmt::format(
+        "Array sizes do not match: {} and {}", lhs.size(), rhs.size()));
+  }
+  std::vector<std::shared_ptr<BasicVariable<T>>> result;
+  result.reserve(lhs.size());
+  for (size_t i = 0; i < lhs.size(); ++i) {
+    result.push_back(f(lhs[i], rhs[i]));
+  }
+  return BasicVariableArray<T>(std::move(result));
+}
+
+template <typename T>
+BasicVariableArray<T> BasicVariableArray<T>::log() const {
+  return map(*this, [](auto &v) { return v->log(); });
+}
+
+template <typename T>
+BasicVariableArray<T> BasicVariableArray<T>::relu() const {
+  return map(*this, [](auto &v) { return v->relu(); });
+}
+
+template <typename T>
+BasicVariableArray<T> BasicVariableArray<T>::sigmoid() const {
+  return map(*this, [](auto &v) { return v->sigmoid(); });
+}
+
+template <typename T>
+std::shared_ptr<BasicVariable<T>> BasicVariableArray<T>::sum() const {
+  if (variables_.empty()) {
+    return std::make_shared<BasicVariable<T>>(0);
+  }
+  // Adds neighbours pairwise, so the graph is log2(size) nodes deep instead
+  // of a chain as long as the array.
+  auto level = variables_;
+  while (level.size() > 1) {
+    size_t half = level.size() / 2;
+    for (size_t i = 0; i < half; ++i) {
+      level[i] = level[2 * i] + level[2 * i + 1];
+    }
+    if (level.size() % 2) {
+      level[half] = level.back();
+    }
+    level.resize(level.size() - half);
+  }
+  return level[0];
+}
+
+#define DEFINE_ARRAY_OPERATOR(op)                                              \
+  template <typename T>                                                        \
+  BasicVariableArray<T> operator op(const BasicVariableArray<T> &lhs,          \
+                                    const BasicVariableArray<T> &rhs) {        \
+    return zip(lhs, rhs, [](auto &a, auto &b) { return a op b; });             \
+  }                                                                            \
+  template <typename T>                                                        \
+  BasicVariableArray<T> operator op(                                           \
+      const BasicVariableArray<T> &lhs,                                        \
+      const std::shared_ptr<BasicVariable<T>> &rhs) {                          \
+    return map(lhs, [&](auto &a) { return a op rhs; });                        \
+  }
+DEFINE_ARRAY_OPERATOR(+)
+DEFINE_ARRAY_OPERATOR(-)
+DEFINE_ARRAY_OPERATOR(*)
+DEFINE_ARRAY_OPERATOR(/)
+#undef DEFINE_ARRAY_OPERATOR
+
+template <typename T>
+BasicVariableArray<T> operator-(const BasicVariableArray<T> &array) {
+  return map(array, [](auto &v) { return -v; });
+}
+
+#define INSTANTIATE_ARRAY_OPERATOR(T, op)                                      \
+  template BasicVariableArray<T> operator op(const BasicVariableArray<T> &,    \
+                                             const BasicVariableArray<T> &);   \
+  template BasicVariableArray<T> operator op(                                  \
+      const BasicVariableArray<T> &, const std::shared_ptr<BasicVariable<T>> &);
+#define INSTANTIATE_ARRAY(T)                                                   \
+  template class BasicVariableArray<T>;                                        \
+  INSTANTIATE_ARRAY_OPERATOR(T, +)                                             \
+  INSTANTIATE_ARRAY_OPERATOR(T, -)                                             \
+  INSTANTIATE_ARRAY_OPERATOR(T, *)                                             \
+  INSTANTIATE_ARRAY_OPERATOR(T, /)                                             \
+  template BasicVariableArray<T> operator-(const BasicVariableArray<T> &);
+AUTOGRAD_FORALL_SCALAR_TYPES(INSTANTIATE_ARRAY)
+#undef INSTANTIATE_ARRAY
+#undef INSTANTIATE_ARRAY_OPERATOR
+
+} // namespace autograd
@@ -1,151 +1,496 @@
 #include <autograd/autograd.h>
-#include <boost/algorithm/string/join.hpp>
+#include <autograd/operators.h>
+#include <autograd/tape.h>
+#include <algorithm>
 #include <boost/log/trivial.hpp>
+#include <cerrno>
+#include <cstring>
 #include <cxxabi.h>
 #include <fmt/format.h>
+#include <fmt/ranges.h>
+#include <functional>
 #include <iostream>
-#include <queue>
-#include <sstream>
 #include <string>
+#include <unistd.h>
 #include <unordered_map>
 
 namespace autograd {
 
-struct NodeTask {
-  std::shared_ptr<Node> fn;
-  variable_list variables;
+namespace {
+
+// Collects the output and hands it to `sink` in large chunks.
+class GraphWriter {
+  static constexpr size_t kBufferSize = 1 << 16;
+
+  std::function<void(const char *, size_t)> sink_;
+  fmt::memory_buffer buffer_;
+
+public:
+  explicit GraphWriter(std::function<void(const char *, size_t)> sink)
+      : sink_(std::move(sink)) {
+    buffer_.reserve(kBufferSize);
+  }
+
+  fmt::memory_buffer &buffer() { return buffer_; }
+
+  template <typename V> void put(V value) {
+    auto bytes = reinterpret_cast<const char *>(&value);
+    buffer_.append(bytes, bytes + sizeof(value));
+  }
+
+  void maybe_flush() {
+    if (buffer_.size() >= kBufferSize) {
+      flush();
+    }
+  }
+
+  void flush() {
+    if (buffer_.size() > 0) {
+      sink_(buffer_.data(), buffer_.size());
+      buffer_.clear();
+    }
+  }
 };
 
-void print_graph(Variable &root) {
-  std::unordered_map<std::shared_ptr<Node>, bool> visited;
-  std::queue<std::shared_ptr<Node>> queue;
-  std::unordered_map<std::shared_ptr<Node>, std::string> node_names;
-  std::unordered_map<std::shared_ptr<Node>, std::vector<std::string>>
-      neighbours;
-
-  auto get_node_name = [&](std::shared_ptr<Node> n) {
-    auto it = node_names.find(n);
-    if (it != node_names.end()) {
-      return it->second;
-    }
-    char *buf =
-        __cxxabiv1::__cxa_demangle(n->name(), nullptr, nullptr, nullptr);
-    std::string&& name = fmt::format("{}_{}", buf + 10, fmt::ptr(n));
-    free(buf);
-    return node_names[n] = std::move(name);
-  };
-
-  queue.push(root.gradient_edge().grad_fn());
-  while (!queue.empty()) {
-    auto node = queue.front();
-    queue.pop();
-    if (!node) {
-      continue;
-    }
-
-    (void)get_node_name(node);
-
-    for (int i = 0; i < node->next_edges(); ++i) {
-      auto edge = node->next_edge(i);
-      auto grad_fn = edge.grad_fn();
-      if (grad_fn) {
-        neighbours[node].push_back(get_node_name(grad_fn));
-        if (!visited[grad_fn]) {
-          visited[grad_fn] = true;
-          queue.push(grad_fn);
+// Built-in nodes are named after their opcode, custom nodes after their
+// demangled type, once per type.
+class NodeNames {
+  std::unordered_map<const char *, std::string> custom_;
+
+public:
+  const char *operator()(Node *node) {
+    if (node->opcode() != OpCode::Custom) {
+      return opcode_name(node->opcode());
+    }
+    const char *mangled = node->name();
+    auto it = custom_.find(mangled);
+    if (it == custom_.end()) {
+      char *buf =
+          __cxxabiv1::__cxa_demangle(mangled, nullptr, nullptr, nullptr);
+      it = custom_.emplace(mangled, buf ? buf : mangled).first;
+      free(buf);
+    }
+    return it->second.c_str();
+  }
+};
+
+size_t export_graph(Node *root, GraphWriter &writer,
+                    const GraphExportOptions &options) {
+  using Format = GraphExportOptions::Format;
+  if (options.format == Format::Dot) {
+    fmt::format_to(std::back_inserter(writer.buffer()), "digraph {{\n");
+  } else {
+    EdgeListHeader header = {};
+    std::copy(std::begin(kEdgeListMagic), std::end(kEdgeListMagic),
+              header.magic);
+    header.version = kEdgeListVersion;
+    writer.put(header);
+  }
+
+  std::unordered_map<Node *, uint32_t> ids;
+  // Ids are handed out in queue order, so the queue only needs depths.
+  std::vector<Node *> queue;
+  std::vector<uint32_t> depths;
+  std::vector<uint32_t> targets;
+  NodeNames names;
+  if (root && options.max_depth > 0 && options.max_nodes > 0) {
+    ids.emplace(root, 0);
+    queue.push_back(root);
+    depths.push_back(0);
+  }
+  for (size_t id = 0; id < queue.size(); ++id) {
+    Node *node = queue[id];
+    targets.clear();
+    for (int e = 0; e < node->next_edges(); ++e) {
+      Node *next = node->next_edge(e).grad_fn().get();
+      if (!next) {
+        continue;
+      }
+      auto it = ids.find(next);
+      if (it == ids.end()) {
+        if (depths[id] + 1 >= options.max_depth ||
+            queue.size() >= options.max_nodes) {
+          continue;
         }
+        it = ids.emplace(next, queue.size()).first;
+        queue.push_back(next);
+        depths.push_back(depths[id] + 1);
       }
+      targets.push_back(it->second);
     }
+
+    if (options.format == Format::Dot) {
+      auto out = std::back_inserter(writer.buffer());
+      fmt::format_to(out, "  {} [label=\"{}\"]\n", id, names(node));
+      if (!targets.empty()) {
+        fmt::format_to(out, "  {} -> {{{}}}\n", id,
+                       fmt::join(targets, " "));
+      }
+    } else {
+      writer.put(node->opcode());
+      writer.put(uint32_t(targets.size()));
+      for (uint32_t target : targets) {
+        writer.put(target);
+      }
+    }
+    writer.maybe_flush();
   }
-  std::cout << "digraph {" << std::endl << std::endl;
-  for (auto &[p, s] : node_names) {
-    std::cout << "  " << s << std::endl;
-  }
-  std::cout << std::endl;
-  for (auto &[p, ns] : neighbours) {
-    fmt::print("  {} -> {{{}}}\n", get_node_name(p),
-               boost::algorithm::join(ns, " "));
+
+  if (options.format == Format::Dot) {
+    fmt::format_to(std::back_inserter(writer.buffer()), "}}\n");
   }
-  std::cout << std::endl << "}" << std::endl;
+  writer.flush();
+  return queue.size();
 }
 
-void compute_dependencies(
-    Variable &root,
-    std::unordered_map<std::shared_ptr<Node>, int> &dependencies) {
-  std::queue<std::shared_ptr<Node>> queue;
-  std::unordered_map<std::shared_ptr<Node>, bool> visited;
-  queue.push(root.gradient_edge().grad_fn());
-  while (!queue.empty()) {
-    auto node = queue.front();
-    queue.pop();
-    if (!node) {
-      continue;
-    }
-
-    for (int i = 0; i < node->next_edges(); ++i) {
-      auto edge = node->next_edge(i);
-      auto grad_fn = edge.grad_fn();
-      if (grad_fn) {
-        dependencies[grad_fn] += 1;
-        if (!visited[grad_fn]) {
-          visited[grad_fn] = true;
-          queue.push(grad_fn);
+} // namespace
+
+size_t export_graph(std::shared_ptr<Node> root, std::ostream &out,
+                    const GraphExportOptions &options) {
+  GraphWriter writer([&](const char *data, size_t size) {
+    if (!out.write(data, size)) {
+      throw std::runtime_error("Cannot write graph");
+    }
+  });
+  size_t nodes = export_graph(root.get(), writer, options);
+  out.flush();
+  return nodes;
+}
+
+size_t export_graph(std::shared_ptr<Node> root, int fd,
+                    const GraphExportOptions &options) {
+  GraphWriter writer([&](const char *data, size_t size) {
+    while (size > 0) {
+      ssize_t written = ::write(fd, data, size);
+      if (written < 0) {
+        if (errno == EINTR) {
+          continue;
         }
+        throw std::runtime_error(
+            fmt::format("Cannot write graph: {}", std::strerror(errno)));
       }
+      data += written;
+      size -= written;
     }
-  }
+  });
+  return export_graph(root.get(), writer, options);
+}
+
+void print_graph(std::shared_ptr<Node> root) {
+  export_graph(root, std::cout);
 }
 
-void run_backward(Variable &root) {
-  std::unordered_map<std::shared_ptr<Node>, int> dependencies;
-  compute_dependencies(root, dependencies);
-  Variable one(1.0);
-  std::queue<NodeTask> queue;
-  std::unordered_map<std::shared_ptr<Node>, NodeTask> not_ready;
-  queue.push({root.gradient_edge().grad_fn(), {one}});
-  while (!queue.empty()) {
-    auto task = queue.front();
-    queue.pop();
-    auto outputs = task.fn->apply(std::move(task.variables));
-    for (unsigned int i = 0; i < outputs.size(); ++i) {
-      auto edge = task.fn->next_edge(i);
-      auto fn = edge.grad_fn();
-      if (!fn)
+GraphStats graph_stats(std::shared_ptr<Node> root) {
+  GraphStats stats;
+  if (!root) {
+    return stats;
+  }
+  // Number the nodes and count the incoming edges of each.
+  std::unordered_map<Node *, uint32_t> ids;
+  std::vector<Node *> nodes;
+  std::vector<uint32_t> fan_in;
+  ids.emplace(root.get(), 0);
+  nodes.push_back(root.get());
+  fan_in.push_back(0);
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    Node *node = nodes[i];
+    for (int e = 0; e < node->next_edges(); ++e) {
+      auto next = node->next_edge(e).grad_fn();
+      if (!next) {
         continue;
-      auto it = dependencies.find(fn);
-
-      bool is_ready = false;
-      if (it == dependencies.end()) {
-        throw std::runtime_error("Dependency not found");
-      } else {
-        if (--it->second == 0) {
-          is_ready = true;
-          dependencies.erase(it);
-        }
       }
+      auto [it, inserted] = ids.emplace(next.get(), nodes.size());
+      if (inserted) {
+        nodes.push_back(next.get());
+        fan_in.push_back(0);
+      }
+      ++fan_in[it->second];
+    }
+  }
+
+  // Longest path from the root, visiting nodes in topological order.
+  std::vector<uint32_t> depth(nodes.size(), 0), pending = fan_in;
+  std::vector<uint32_t> ready{0};
+  std::vector<size_t> width;
+  while (!ready.empty()) {
+    uint32_t id = ready.back();
+    ready.pop_back();
+    Node *node = nodes[id];
+    if (depth[id] >= width.size()) {
+      width.resize(depth[id] + 1);
+    }
+    ++width[depth[id]];
+    size_t fan_out = 0;
+    for (int e = 0; e < node->next_edges(); ++e) {
+      auto next = node->next_edge(e).grad_fn();
+      if (!next) {
+        continue;
+      }
+      ++fan_out;
+      uint32_t next_id = ids[next.get()];
+      depth[next_id] = std::max(depth[next_id], depth[id] + 1);
+      if (--pending[next_id] == 0) {
+        ready.push_back(next_id);
+      }
+    }
+    if (fan_out >= stats.fan_out.size()) {
+      stats.fan_out.resize(fan_out + 1);
+    }
+    ++stats.fan_out[fan_out];
+    if (fan_in[id] >= stats.fan_in.size()) {
+      stats.fan_in.resize(fan_in[id] + 1);
+    }
+    ++stats.fan_in[fan_in[id]];
+    stats.edges += fan_out;
+    stats.node_bytes += node->bytes();
+    stats.saved_bytes += node->saved_bytes();
+    ++stats.nodes_by_op[(int)node->opcode()];
+  }
+  stats.nodes = nodes.size();
+  stats.depth = width.size();
+  stats.width = *std::max_element(width.begin(), width.end());
+  return stats;
+}
+
+namespace {
+
+constexpr uint32_t kNoSlot = UINT32_MAX;
+
+// A node of the backward graph flattened for the engine. Its incoming
+// gradients are grads[grad, grad + inputs), the gradients it produces go to
+// the slots next_slots[next, next + nexts) of the nodes next_ids[next, next +
+// nexts). `pending` counts the incoming edges whose gradients are missing.
+template <typename A> struct BackwardRecord {
+  explicit BackwardRecord(Node *node)
+      : node(node), op(node->opcode()), grad(0), inputs(0), next(0), nexts(0),
+        pending(0), a(0), b(0) {}
+
+  Node *node;
+  OpCode op;
+  uint32_t grad;
+  uint32_t inputs;
+  uint32_t next;
+  uint32_t nexts;
+  uint32_t pending;
+  // Forward values saved by the node.
+  A a;
+  A b;
+};
+
+// Opcodes other than Custom are only used by the nodes in operators.h, so
+// the opcode tells the concrete type.
+template <typename T>
+void load_saved(Node *node, acc_type<T> &a, acc_type<T> &b) {
+  switch (node->opcode()) {
+  case OpCode::Mul: {
+    auto n = static_cast<MulBackward<T> *>(node);
+    a = n->self_->value_, b = n->other_->value_;
+    break;
+  }
+  case OpCode::Div: {
+    auto n = static_cast<DivBackward<T> *>(node);
+    a = n->self_->value_, b = n->other_->value_;
+    break;
+  }
+  case OpCode::Pow: {
+    auto n = static_cast<PowBackward<T> *>(node);
+    a = n->self_->value_, b = n->other_->value_;
+    break;
+  }
+  case OpCode::Log:
+    a = static_cast<LogBackward<T> *>(node)->self_->value_;
+    break;
+  case OpCode::ReLU:
+    a = static_cast<ReLUBackward<T> *>(node)->self_->value_;
+    break;
+  default:
+    break;
+  }
+}
+
+template <typename T> class BackwardEngine {
+  using A = acc_type<T>;
 
-      auto not_ready_it = not_ready.find(fn);
-      if (not_ready_it == not_ready.end()) {
-        variable_list inputs(fn->input_nr());
-        inputs[edge.input_nr()].value_ += outputs[i].value_;
-        if (is_ready) {
-          queue.push({fn, std::move(inputs)});
+  std::vector<BackwardRecord<A>> records_;
+  std::vector<uint32_t> next_slots_;
+  std::vector<uint32_t> next_ids_;
+  std::vector<A> grads_;
+  // Ready nodes by opcode, nodes with the same opcode run in one loop.
+  std::vector<uint32_t> ready_[kNumOpCodes];
+  std::vector<uint32_t> batch_;
+
+  // Numbers the nodes reachable from `root`, counts their incoming edges and
+  // lays out their gradients.
+  void build(Node *root) {
+    std::unordered_map<Node *, uint32_t> ids;
+    ids.emplace(root, 0);
+    records_.emplace_back(root);
+    for (size_t id = 0; id < records_.size(); ++id) {
+      Node *node = records_[id].node;
+      for (int e = 0; e < node->next_edges(); ++e) {
+        Node *next = node->next_edge(e).grad_fn().get();
+        if (!next) {
+          continue;
+        }
+        auto [it, inserted] = ids.emplace(next, records_.size());
+        if (inserted) {
+          records_.emplace_back(next);
+        }
+        ++records_[it->second].pending;
+      }
+    }
+    uint32_t slots = 0;
+    for (auto &record : records_) {
+      record.grad = slots;
+      record.inputs = record.node->input_nr();
+      slots += record.inputs;
+      load_saved<T>(record.node, record.a, record.b);
+    }
+    grads_.assign(slots, A(0));
+    for (auto &record : records_) {
+      record.next = next_slots_.size();
+      record.nexts = record.node->next_edges();
+      for (uint32_t e = 0; e < record.nexts; ++e) {
+        const Edge &edge = record.node->next_edge(e);
+        Node *next = edge.grad_fn().get();
+        if (next) {
+          uint32_t id = ids[next];
+          next_ids_.push_back(id);
+          next_slots_.push_back(records_[id].grad + edge.input_nr());
         } else {
-          not_ready[fn] = NodeTask{fn, std::move(inputs)};
+          next_ids_.push_back(kNoSlot);
+          next_slots_.push_back(kNoSlot);
         }
-      } else {
-        (not_ready_it->second).variables[edge.input_nr()].value_ +=
-            outputs[i].value_;
-        if (is_ready) {
-          queue.push(std::move(not_ready_it->second));
-          not_ready.erase(not_ready_it);
+      }
+    }
+  }
+
+  void add(uint32_t slot, A grad) {
+    if (slot != kNoSlot) {
+      grads_[slot] += grad;
+    }
+  }
+
+  template <OpCode Op> void run_batch() {
+    for (uint32_t id : batch_) {
+      auto &r = records_[id];
+      A grad_a = 0, grad_b = 0;
+      backward_kernel<A>(Op, r.a, r.b, grads_[r.grad], grad_a, grad_b);
+      add(next_slots_[r.next], grad_a);
+      if (opcode_arity(Op) == 2) {
+        add(next_slots_[r.next + 1], grad_b);
+      }
+    }
+  }
+
+  void run_accumulate() {
+    for (uint32_t id : batch_) {
+      auto &r = records_[id];
+      auto node = static_cast<AccumulateGrad<T> *>(r.node);
+      if (auto variable = node->variable_.lock()) {
+        variable->grad_ += grads_[r.grad];
+      }
+    }
+  }
+
+  // Nodes defined outside the library go through BasicNode::apply.
+  void run_custom() {
+    for (uint32_t id : batch_) {
+      auto &r = records_[id];
+      variable_list<T> inputs(r.inputs);
+      for (uint32_t i = 0; i < r.inputs; ++i) {
+        inputs[i].value_ = grads_[r.grad + i];
+      }
+      auto outputs =
+          static_cast<BasicNode<T> *>(r.node)->apply(std::move(inputs));
+      for (uint32_t i = 0; i < outputs.size() && i < r.nexts; ++i) {
+        add(next_slots_[r.next + i], outputs[i].value_);
+      }
+    }
+  }
+
+  void run_batch(OpCode op) {
+    switch (op) {
+    case OpCode::Add:
+      return run_batch<OpCode::Add>();
+    case OpCode::Sub:
+      return run_batch<OpCode::Sub>();
+    case OpCode::Mul:
+      return run_batch<OpCode::Mul>();
+    case OpCode::Div:
+      return run_batch<OpCode::Div>();
+    case OpCode::Pow:
+      return run_batch<OpCode::Pow>();
+    case OpCode::Log:
+      return run_batch<OpCode::Log>();
+    case OpCode::ReLU:
+      return run_batch<OpCode::ReLU>();
+    case OpCode::Neg:
+      return run_batch<OpCode::Neg>();
+    case OpCode::AccumulateGrad:
+      return run_accumulate();
+    default:
+      return run_custom();
+    }
+  }
+
+public:
+  void run(const Edge &root, A grad) {
+    if (!root.grad_fn()) {
+      return;
+    }
+    build(root.grad_fn().get());
+    grads_[root.input_nr()] += grad;
+    ready_[(int)records_[0].op].push_back(0);
+    bool progress = true;
+    while (progress) {
+      progress = false;
+      for (int op = 0; op < kNumOpCodes; ++op) {
+        if (ready_[op].empty()) {
+          continue;
+        }
+        progress = true;
+        batch_.swap(ready_[op]);
+        run_batch(OpCode(op));
+        for (uint32_t id : batch_) {
+          auto &record = records_[id];
+          for (uint32_t e = 0; e < record.nexts; ++e) {
+            uint32_t next = next_ids_[record.next + e];
+            if (next != kNoSlot && --records_[next].pending == 0) {
+              ready_[(int)records_[next].op].push_back(next);
+            }
+          }
         }
+        batch_.clear();
+      }
+    }
+    // Only a cycle leaves nodes waiting for gradients.
+    for (auto &record : records_) {
+      if (record.pending != 0) {
+        throw std::runtime_error("Some tasks are not finished");
       }
     }
   }
-  if (!not_ready.empty()) {
-    throw std::runtime_error("Some tasks are not finished");
+};
+
+} // namespace
+
+template <typename T>
+void run_backward(BasicVariable<T> &root, acc_type<T> grad) {
+  if (auto tape = Tape<T>::owner(root)) {
+    tape->backward(root, grad);
+    return;
+  }
+  if (root.tape_output_) {
+    throw std::runtime_error(
+        "Variable was produced by a tape that is stopped or cleared");
   }
+  BackwardEngine<T>().run(root.gradient_edge(), grad);
 }
 
+#define INSTANTIATE_RUN_BACKWARD(T)                                            \
+  template void run_backward(BasicVariable<T> &, acc_type<T>);
+AUTOGRAD_FORALL_SCALAR_TYPES(INSTANTIATE_RUN_BACKWARD)
+#undef INSTANTIATE_RUN_BACKWARD
+
 } // namespace autograd
\ No newline at end of file
@@ -0,0 +1,266 @@
+#include "autograd/checkpoint.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fmt/format.h>
+
+namespace autograd {
+
+// Elements per write when streaming parameters out.
+static constexpr size_t kStreamChunk = 4096;
+
+CheckpointWriter::CheckpointWriter(const std::string &path)
+    : path_(path), out_(path, std::ios::binary | std::ios::trunc) {
+  if (!out_) {
+    throw std::runtime_error(fmt::format("Cannot open {} for writing", path));
+  }
+  CheckpointHeader header{};
+  out_.write(reinterpret_cast<const char *>(&header), sizeof(header));
+}
+
+CheckpointWriter::~CheckpointWriter() {
+  if (out_.is_open()) {
+    try {
+      close();
+    } catch (std::exception &e) {
+      BOOST_LOG_TRIVIAL(error) << e.what();
+    }
+  }
+}
+
+void CheckpointWriter::align() {
+  static const char zeros[kCheckpointAlignment] = {};
+  size_t offset = out_.tellp();
+  size_t padding = (kCheckpointAlignment - offset % kCheckpointAlignment) %
+                   kCheckpointAlignment;
+  out_.write(zeros, padding);
+}
+
+void CheckpointWriter::write_section(const std::string &name, EntryKind kind,
+                                     ScalarType dtype, const void *data,
+                                     size_t count, size_t element_size) {
+  if (name.size() >= sizeof(CheckpointEntry::name)) {
+    throw std::invalid_argument(
+        fmt::format("Checkpoint entry name too long: {}", name));
+  }
+  for (auto &entry : entries_) {
+    if (entry.kind == kind && name == entry.name) {
+      throw std::invalid_argument(
+          fmt::format("Duplicate checkpoint entry {}", name));
+    }
+  }
+  CheckpointEntry entry{};
+  std::strncpy(entry.name, name.c_str(), sizeof(entry.name) - 1);
+  entry.kind = kind;
+  entry.dtype = dtype;
+  entry.count = count;
+  align();
+  entry.offset = out_.tellp();
+  if (data) {
+    out_.write(static_cast<const char *>(data), count * element_size);
+  }
+  entries_.push_back(entry);
+}
+
+template <typename T>
+void CheckpointWriter::add_parameters(
+    const std::string &name,
+    const std::shared_ptr<BasicVariable<T>> *parameters, size_t count) {
+  using A = acc_type<T>;
+  std::vector<T> values(std::min(kStreamChunk, count));
+  std::vector<A> grads(values.size());
+
+  write_section(name, EntryKind::Values, scalar_type_of<T>::value, nullptr,
+                count, sizeof(T));
+  for (size_t begin = 0; begin < count; begin += kStreamChunk) {
+    size_t n = std::min(kStreamChunk, count - begin);
+    for (size_t i = 0; i < n; ++i) {
+      values[i] = parameters[begin + i]->value_;
+    }
+    out_.write(reinterpret_cast<const char *>(values.data()), n * sizeof(T));
+  }
+
+  write_section(name, EntryKind::Grads, scalar_type_of<A>::value, nullptr,
+                count, sizeof(A));
+  for (size_t begin = 0; begin < count; begin += kStreamChunk) {
+    size_t n = std::min(kStreamChunk, count - begin);
+    for (size_t i = 0; i < n; ++i) {
+      grads[i] = parameters[begin + i]->grad_;
+    }
+    out_.write(reinterpret_cast<const char *>(grads.data()), n * sizeof(A));
+  }
+}
+
+void CheckpointWriter::add_optimizer(const std::string &name, const SGD &sgd) {
+  double state[] = {sgd.learning_rate_};
+  write_section(name, EntryKind::Optimizer, ScalarType::Float64, state,
+                std::size(state), sizeof(double));
+}
+
+void CheckpointWriter::add_grad_scaler(const std::string &name,
+                                       const GradScaler &scaler) {
+  double state[] = {scaler.scale_, scaler.growth_factor_,
+                    scaler.backoff_factor_, (double)scaler.growth_interval_,
+                    (double)scaler.growth_tracker_};
+  write_section(name, EntryKind::Optimizer, ScalarType::Float64, state,
+                std::size(state), sizeof(double));
+}
+
+void CheckpointWriter::close() {
+  align();
+  CheckpointHeader header{};
+  std::memcpy(header.magic, kCheckpointMagic, sizeof(header.magic));
+  header.version = kCheckpointVersion;
+  header.alignment = kCheckpointAlignment;
+  header.num_entries = entries_.size();
+  header.index_offset = out_.tellp();
+  header.file_size =
+      header.index_offset + entries_.size() * sizeof(CheckpointEntry);
+  out_.write(reinterpret_cast<const char *>(entries_.data()),
+             entries_.size() * sizeof(CheckpointEntry));
+  out_.seekp(0);
+  out_.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  out_.close();
+  if (!out_) {
+    throw std::runtime_error(fmt::format("Failed writing {}", path_));
+  }
+}
+
+static size_t element_size(ScalarType dtype) {
+  switch (dtype) {
+  case ScalarType::Float32:
+    return 4;
+  case ScalarType::Float64:
+    return 8;
+  case ScalarType::Float16:
+  case ScalarType::BFloat16:
+    return 2;
+  }
+  return 0;
+}
+
+Checkpoint::Checkpoint(const std::string &path) : file_(path) {
+  if (file_.size() < sizeof(CheckpointHeader)) {
+    throw std::runtime_error(fmt::format("{} is not a checkpoint", path));
+  }
+  header_ = reinterpret_cast<const CheckpointHeader *>(file_.data());
+  if (std::memcmp(header_->magic, kCheckpointMagic, sizeof(header_->magic))) {
+    throw std::runtime_error(fmt::format("{} is not a checkpoint", path));
+  }
+  if (header_->version != kCheckpointVersion) {
+    throw std::runtime_error(fmt::format(
+        "{} has unsupported checkpoint version {}", path, header_->version));
+  }
+  if (header_->file_size != file_.size() ||
+      header_->index_offset % alignof(CheckpointEntry) ||
+      header_->index_offset > file_.size() ||
+      header_->num_entries >
+          (file_.size() - header_->index_offset) / sizeof(CheckpointEntry)) {
+    throw std::runtime_error(fmt::format("{} is truncated", path));
+  }
+  // Entries are mapped in place, so every dtype must be aligned.
+  uint32_t alignment = header_->alignment;
+  if (alignment < alignof(double) || (alignment & (alignment - 1))) {
+    throw std::runtime_error(
+        fmt::format("{} has an invalid alignment {}", path, alignment));
+  }
+  entries_ = reinterpret_cast<const CheckpointEntry *>(file_.data() +
+                                                       header_->index_offset);
+  for (size_t i = 0; i < header_->num_entries; ++i) {
+    auto &entry = entries_[i];
+    size_t size = element_size(entry.dtype);
+    if (size == 0 || entry.offset % header_->alignment ||
+        entry.offset > header_->index_offset ||
+        entry.count > (header_->index_offset - entry.offset) / size) {
+      throw std::runtime_error(
+          fmt::format("{} has a corrupt entry {}", path, i));
+    }
+    // find() returns the first match, a second one would be unreachable.
+    if (find(std::string(entry.name, strnlen(entry.name, sizeof(entry.name))),
+             entry.kind) != &entry) {
+      throw std::runtime_error(
+          fmt::format("{} has a duplicate entry {}", path, i));
+    }
+  }
+}
+
+const CheckpointEntry *Checkpoint::find(const std::string &name,
+                                        EntryKind kind) const {
+  for (size_t i = 0; i < header_->num_entries; ++i) {
+    if (entries_[i].kind == kind &&
+        !strncmp(entries_[i].name, name.c_str(), sizeof(entries_[i].name))) {
+      return &entries_[i];
+    }
+  }
+  return nullptr;
+}
+
+const CheckpointEntry &Checkpoint::get(const std::string &name,
+                                       EntryKind kind,
+                                       ScalarType dtype) const {
+  auto entry = find(name, kind);
+  if (!entry) {
+    throw std::runtime_error(
+        fmt::format("Checkpoint entry {} not found", name));
+  }
+  if (entry->dtype != dtype) {
+    throw std::runtime_error(
+        fmt::format("Checkpoint entry {} has a different dtype", name));
+  }
+  return *entry;
+}
+
+template <typename T>
+void Checkpoint::load_parameters(
+    const std::string &name,
+    const std::shared_ptr<BasicVariable<T>> *parameters, size_t count) const {
+  using A = acc_type<T>;
+  auto &values = get(name, EntryKind::Values, scalar_type_of<T>::value);
+  auto &grads = get(name, EntryKind::Grads, scalar_type_of<A>::value);
+  if (values.count != count || grads.count != count) {
+    throw std::runtime_error(fmt::format(
+        "Checkpoint entry {} has {} parameters, expected {}", name,
+        values.count, count));
+  }
+  const T *value_data = data<T>(values);
+  const A *grad_data = data<A>(grads);
+  for (size_t i = 0; i < count; ++i) {
+    parameters[i]->value_ = value_data[i];
+    parameters[i]->grad_ = grad_data[i];
+  }
+}
+
+void Checkpoint::load_optimizer(const std::string &name, SGD &sgd) const {
+  auto &entry = get(name, EntryKind::Optimizer, ScalarType::Float64);
+  if (entry.count != 1) {
+    throw std::runtime_error(
+        fmt::format("Checkpoint entry {} is not an SGD state", name));
+  }
+  sgd.learning_rate_ = data<double>(entry)[0];
+}
+
+void Checkpoint::load_grad_scaler(const std::string &name,
+                                  GradScaler &scaler) const {
+  auto &entry = get(name, EntryKind::Optimizer, ScalarType::Float64);
+  if (entry.count != 5) {
+    throw std::runtime_error(
+        fmt::format("Checkpoint entry {} is not a GradScaler state", name));
+  }
+  const double *state = data<double>(entry);
+  scaler.scale_ = state[0];
+  scaler.growth_factor_ = state[1];
+  scaler.backoff_factor_ = state[2];
+  scaler.growth_interval_ = state[3];
+  scaler.growth_tracker_ = state[4];
+}
+
+#define INSTANTIATE_CHECKPOINT(T)                                              \
+  template void CheckpointWriter::add_parameters(                              \
+      const std::string &, const std::shared_ptr<BasicVariable<T>> *, size_t); \
+  template void Checkpoint::load_parameters(                                   \
+      const std::string &, const std::shared_ptr<BasicVariable<T>> *, size_t)  \
+      const;
+AUTOGRAD_FORALL_SCALAR_TYPES(INSTANTIATE_CHECKPOINT)
+#undef INSTANTIATE_CHECKPOINT
+
+} // namespace autograd
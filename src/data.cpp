@@ -0,0 +1,249 @@
+#include "autograd/data.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fmt/format.h>
+#include <random>
+#include <stdexcept>
+
+namespace autograd {
+
+BinaryDataset::BinaryDataset(const std::string &path, size_t width)
+    : file_(path), width_(width) {
+  if (width_ == 0 || file_.size() % (width_ * sizeof(float)) != 0) {
+    throw std::runtime_error(fmt::format(
+        "{}: size {} is not a multiple of rows of {} floats", path,
+        file_.size(), width_));
+  }
+}
+
+size_t BinaryDataset::size() const {
+  return file_.size() / (width_ * sizeof(float));
+}
+
+void BinaryDataset::read(size_t i, float *row) const {
+  std::memcpy(row, file_.data() + i * width_ * sizeof(float),
+              width_ * sizeof(float));
+}
+
+// Parses the fields of the line starting at `begin` into `row`, returns the
+// number of fields. At most `width` fields are stored.
+static size_t parse_line(const char *begin, const char *end, float *row,
+                         size_t width) {
+  size_t fields = 0;
+  const char *p = begin;
+  while (true) {
+    const char *field_end = std::find(p, end, ',');
+    // The mapping is not null terminated, strtof needs a copy.
+    char buffer[64];
+    size_t length = field_end - p;
+    if (length >= sizeof(buffer)) {
+      throw std::runtime_error(
+          fmt::format("Field of {} characters is too long", length));
+    }
+    std::memcpy(buffer, p, length);
+    buffer[length] = 0;
+    char *parsed;
+    float value = std::strtof(buffer, &parsed);
+    while (*parsed == ' ' || *parsed == '\r' || *parsed == '\t') {
+      ++parsed;
+    }
+    if (parsed == buffer || *parsed != 0) {
+      throw std::runtime_error(fmt::format("Invalid number \"{}\"", buffer));
+    }
+    if (fields < width) {
+      row[fields] = value;
+    }
+    ++fields;
+    if (field_end == end) {
+      return fields;
+    }
+    p = field_end + 1;
+  }
+}
+
+static const char *line_end(const char *begin, const char *end) {
+  return std::find(begin, end, '\n');
+}
+
+CsvDataset::CsvDataset(const std::string &path, bool header)
+    : file_(path), header_(header) {
+  const char *data = file_.data(), *end = data + file_.size();
+  const char *p = data;
+  if (header_ && p != end) {
+    p = std::min(line_end(p, end) + 1, end);
+  }
+  while (p != end) {
+    const char *eol = line_end(p, end);
+    if (std::any_of(p, eol,
+                    [](unsigned char c) { return !std::isspace(c); })) {
+      lines_.push_back(p - data);
+    }
+    p = eol == end ? end : eol + 1;
+  }
+  if (!lines_.empty()) {
+    const char *first = data + lines_[0];
+    width_ = 1 + std::count(first, line_end(first, end), ',');
+  }
+}
+
+void CsvDataset::read(size_t i, float *row) const {
+  const char *end = file_.data() + file_.size();
+  const char *begin = file_.data() + lines_[i];
+  size_t fields;
+  try {
+    fields = parse_line(begin, line_end(begin, end), row, width_);
+  } catch (const std::runtime_error &e) {
+    throw std::runtime_error(
+        fmt::format("Row {}: {}", i + header_ + 1, e.what()));
+  }
+  if (fields != width_) {
+    throw std::runtime_error(fmt::format("Row {}: expected {} fields, got {}",
+                                         i + header_ + 1, width_, fields));
+  }
+}
+
+Batch::Batch(const float *values, size_t rows, size_t width)
+    : rows_(rows), width_(width), values_(values, rows * width) {
+  values_.set_requires_grad(false);
+}
+
+DataLoader::DataLoader(std::shared_ptr<const Dataset> dataset,
+                       const DataLoaderOptions &options)
+    : dataset_(std::move(dataset)), options_(options),
+      queue_(std::max<size_t>(options.prefetch, 1)) {
+  if (options_.batch_size == 0) {
+    throw std::invalid_argument("Batch size must be positive");
+  }
+  thread_ = std::thread(&DataLoader::run, this);
+}
+
+DataLoader::~DataLoader() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  not_full_.notify_one();
+  thread_.join();
+}
+
+// The fences pair a side raising its waiting flag and retrying under the
+// mutex with the other side changing the queue and reading the flag: at least
+// one of them sees the other, so a wakeup cannot be lost.
+void DataLoader::wake(std::atomic<bool> &waiting,
+                      std::condition_variable &cv) {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (waiting.load(std::memory_order_relaxed)) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    cv.notify_one();
+  }
+}
+
+bool DataLoader::push(std::unique_ptr<Batch> batch) {
+  if (!queue_.push(std::move(batch))) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    producer_waiting_.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    while (!queue_.push(std::move(batch))) {
+      if (stop_) {
+        producer_waiting_.store(false, std::memory_order_relaxed);
+        return false;
+      }
+      not_full_.wait(lock);
+    }
+    producer_waiting_.store(false, std::memory_order_relaxed);
+  }
+  wake(consumer_waiting_, not_empty_);
+  return true;
+}
+
+void DataLoader::run() {
+  try {
+    size_t width = dataset_->width(), size = dataset_->size();
+    size_t capacity = std::min(options_.shuffle_buffer, size);
+    std::mt19937_64 random(options_.seed);
+    std::vector<float> rows(std::max<size_t>(capacity, 1) * width);
+    std::vector<float> batch;
+    batch.reserve(options_.batch_size * width);
+
+    auto emit = [&](const float *row) {
+      batch.insert(batch.end(), row, row + width);
+      if (batch.size() < options_.batch_size * width) {
+        return true;
+      }
+      bool pushed = push(std::make_unique<Batch>(
+          batch.data(), options_.batch_size, width));
+      batch.clear();
+      return pushed;
+    };
+
+    if (capacity == 0) {
+      for (size_t i = 0; i < size; ++i) {
+        dataset_->read(i, rows.data());
+        if (!emit(rows.data())) {
+          return;
+        }
+      }
+    } else {
+      // Emit a random row of the buffer and put the next row in its place.
+      for (size_t i = 0; i < capacity; ++i) {
+        dataset_->read(i, &rows[i * width]);
+      }
+      std::uniform_int_distribution<size_t> pick(0, capacity - 1);
+      for (size_t i = capacity; i < size; ++i) {
+        float *row = &rows[pick(random) * width];
+        if (!emit(row)) {
+          return;
+        }
+        dataset_->read(i, row);
+      }
+      std::vector<size_t> order(capacity);
+      for (size_t i = 0; i < capacity; ++i) {
+        order[i] = i;
+      }
+      std::shuffle(order.begin(), order.end(), random);
+      for (size_t i : order) {
+        if (!emit(&rows[i * width])) {
+          return;
+        }
+      }
+    }
+    if (!batch.empty() && !options_.drop_last) {
+      if (!push(std::make_unique<Batch>(batch.data(), batch.size() / width,
+                                        width))) {
+        return;
+      }
+    }
+  } catch (...) {
+    error_ = std::current_exception();
+  }
+  push(nullptr);
+}
+
+std::unique_ptr<Batch> DataLoader::next() {
+  std::unique_ptr<Batch> batch;
+  if (done_) {
+    return batch;
+  }
+  if (!queue_.pop(batch)) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    consumer_waiting_.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    while (!queue_.pop(batch)) {
+      not_empty_.wait(lock);
+    }
+    consumer_waiting_.store(false, std::memory_order_relaxed);
+  }
+  wake(producer_waiting_, not_full_);
+  if (!batch) {
+    done_ = true;
+    if (error_) {
+      std::rethrow_exception(error_);
+    }
+  }
+  return batch;
+}
+
+} // namespace autograd
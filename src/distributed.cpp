@@ -0,0 +1,272 @@
+#include "autograd/distributed.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fmt/format.h>
+#include <new>
+#include <sched.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+namespace autograd {
+
+static constexpr uint32_t kShmMagic = 0x41475348; // "AGSH"
+// Written over the magic of a segment left behind by an earlier run, so ranks
+// that attached to it in the meantime go looking for the new one.
+static constexpr uint32_t kShmRetired = 0x44414544; // "DEAD"
+static constexpr size_t kShmAlignment = 64;
+static constexpr auto kAttachTimeout = std::chrono::seconds(30);
+
+struct ShmHeader {
+  std::atomic<uint32_t> magic;
+  uint32_t world_size;
+  uint64_t capacity;
+  // Ranks other than 0 take a ticket when they attach, rank 0 sets `ready`
+  // once all world_size - 1 tickets are gone. A segment with no tickets left
+  // belongs to another run.
+  std::atomic<uint32_t> joined;
+  std::atomic<uint32_t> ready;
+  alignas(kShmAlignment) std::atomic<uint32_t> arrived;
+  alignas(kShmAlignment) std::atomic<uint32_t> sense;
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free,
+              "shared-memory barrier needs address-free atomics");
+
+static size_t slots_offset() {
+  return (sizeof(ShmHeader) + kShmAlignment - 1) / kShmAlignment *
+         kShmAlignment;
+}
+
+static std::pair<size_t, size_t> chunk(size_t count, int world_size, int c) {
+  return {count * c / world_size, count * (c + 1) / world_size};
+}
+
+// Maps at least `size` bytes of the segment called `name`, or returns nullptr
+// if it does not exist or is still smaller than that.
+static ShmHeader *map_segment(const std::string &name, size_t size) {
+  int fd = shm_open(name.c_str(), O_RDWR, 0600);
+  if (fd < 0) {
+    return nullptr;
+  }
+  struct stat st;
+  void *base = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && (size_t)st.st_size >= size) {
+    base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  return base == MAP_FAILED ? nullptr : static_cast<ShmHeader *>(base);
+}
+
+// Marks a segment left behind by a crashed run as dead and removes its name.
+static void retire_segment(const std::string &name) {
+  if (ShmHeader *stale = map_segment(name, sizeof(ShmHeader))) {
+    stale->magic.store(kShmRetired, std::memory_order_release);
+    munmap(stale, sizeof(ShmHeader));
+  }
+  shm_unlink(name.c_str());
+}
+
+ShmCommunicator::ShmCommunicator(std::string name, int rank, int world_size,
+                                 size_t capacity)
+    : name_(std::move(name)), rank_(rank), world_size_(world_size),
+      capacity_(capacity) {
+  if (world_size_ <= 0 || rank_ < 0 || rank_ >= world_size_) {
+    throw std::invalid_argument(
+        fmt::format("Invalid rank {} for world size {}", rank_, world_size_));
+  }
+  mapped_size_ = slots_offset() + sizeof(float) * capacity_ * world_size_;
+
+  auto deadline = std::chrono::steady_clock::now() + kAttachTimeout;
+  auto check_deadline = [&](const char *what) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      if (header_) {
+        munmap(header_, mapped_size_);
+        header_ = nullptr;
+      }
+      if (rank_ == 0) {
+        shm_unlink(name_.c_str());
+      }
+      throw std::runtime_error(fmt::format("Timed out {} {}", what, name_));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  };
+
+  if (rank_ == 0) {
+    retire_segment(name_);
+    int fd = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0 || ftruncate(fd, mapped_size_) != 0) {
+      int error = errno;
+      if (fd >= 0) {
+        close(fd);
+        shm_unlink(name_.c_str());
+      }
+      throw std::runtime_error(fmt::format("Cannot create shared memory {}: {}",
+                                           name_, std::strerror(error)));
+    }
+    void *base = mmap(nullptr, mapped_size_, PROT_READ | PROT_WRITE,
+                      MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+      shm_unlink(name_.c_str());
+      throw std::runtime_error(fmt::format("Cannot map shared memory {}: {}",
+                                           name_, std::strerror(errno)));
+    }
+    header_ = new (base) ShmHeader();
+    header_->world_size = world_size_;
+    header_->capacity = capacity_;
+    header_->joined.store(0, std::memory_order_relaxed);
+    header_->ready.store(0, std::memory_order_relaxed);
+    header_->arrived.store(0, std::memory_order_relaxed);
+    header_->sense.store(0, std::memory_order_relaxed);
+    header_->magic.store(kShmMagic, std::memory_order_release);
+    while (header_->joined.load(std::memory_order_acquire) !=
+           (uint32_t)world_size_ - 1) {
+      check_deadline("waiting for the other ranks on");
+    }
+    header_->ready.store(1, std::memory_order_release);
+  } else {
+    // The name may still refer to the segment of a crashed run until rank 0
+    // retires it, so only a segment that hands out a ticket and is then
+    // marked ready by rank 0 is joined.
+    for (;;) {
+      header_ = map_segment(name_, mapped_size_);
+      if (header_ &&
+          header_->magic.load(std::memory_order_acquire) == kShmMagic &&
+          header_->world_size == (uint32_t)world_size_ &&
+          header_->capacity == capacity_ &&
+          header_->joined.fetch_add(1, std::memory_order_acq_rel) <
+              (uint32_t)world_size_ - 1) {
+        while (header_->ready.load(std::memory_order_acquire) == 0 &&
+               header_->magic.load(std::memory_order_acquire) == kShmMagic) {
+          check_deadline("waiting for rank 0 on");
+        }
+        if (header_->ready.load(std::memory_order_acquire) != 0) {
+          break;
+        }
+      }
+      if (header_) {
+        munmap(header_, mapped_size_);
+        header_ = nullptr;
+      }
+      check_deadline("attaching to shared memory");
+    }
+  }
+  slots_ = reinterpret_cast<float *>(reinterpret_cast<char *>(header_) +
+                                     slots_offset());
+
+  // Once everyone is attached the name is no longer needed, and unlinking it
+  // here means a finished run does not leak the segment.
+  barrier();
+  if (rank_ == 0) {
+    shm_unlink(name_.c_str());
+  }
+}
+
+ShmCommunicator::~ShmCommunicator() {
+  if (header_) {
+    munmap(header_, mapped_size_);
+  }
+}
+
+std::unique_ptr<ShmCommunicator> ShmCommunicator::from_env(size_t capacity) {
+  const char *name = std::getenv("AUTOGRAD_SHM_NAME");
+  const char *rank = std::getenv("AUTOGRAD_RANK");
+  const char *world_size = std::getenv("AUTOGRAD_WORLD_SIZE");
+  if (!name || !rank || !world_size) {
+    throw std::runtime_error("AUTOGRAD_SHM_NAME, AUTOGRAD_RANK and "
+                             "AUTOGRAD_WORLD_SIZE must be set");
+  }
+  return std::make_unique<ShmCommunicator>(name, std::atoi(rank),
+                                           std::atoi(world_size), capacity);
+}
+
+void ShmCommunicator::barrier() {
+  sense_ = !sense_;
+  if (header_->arrived.fetch_add(1, std::memory_order_acq_rel) ==
+      (uint32_t)world_size_ - 1) {
+    header_->arrived.store(0, std::memory_order_relaxed);
+    header_->sense.store(sense_, std::memory_order_release);
+  } else {
+    while (header_->sense.load(std::memory_order_acquire) != (uint32_t)sense_) {
+      sched_yield();
+    }
+  }
+}
+
+void ShmCommunicator::all_reduce(float *data, size_t count) {
+  if (count > capacity_) {
+    throw std::invalid_argument(fmt::format(
+        "all_reduce of {} elements exceeds capacity {}", count, capacity_));
+  }
+  float *mine = slot(rank_);
+  const float *left = slot((rank_ + world_size_ - 1) % world_size_);
+  std::copy(data, data + count, mine);
+  barrier();
+
+  // Reduce-scatter: in step s, accumulate chunk (rank - 1 - s) from the left
+  // neighbour, which finished reducing it in step s - 1. Afterwards this rank
+  // holds the complete sum of chunk (rank + 1).
+  for (int s = 0; s < world_size_ - 1; ++s) {
+    int c = (rank_ - 1 - s + 2 * world_size_) % world_size_;
+    auto [begin, end] = chunk(count, world_size_, c);
+    for (size_t i = begin; i < end; ++i) {
+      mine[i] += left[i];
+    }
+    barrier();
+  }
+
+  // All-gather: in step s, copy the complete chunk (rank - s) from the left.
+  for (int s = 0; s < world_size_ - 1; ++s) {
+    int c = (rank_ - s + world_size_) % world_size_;
+    auto [begin, end] = chunk(count, world_size_, c);
+    std::copy(left + begin, left + end, mine + begin);
+    barrier();
+  }
+
+  std::copy(mine, mine + count, data);
+}
+
+void ShmCommunicator::broadcast(float *data, size_t count, int root) {
+  if (count > capacity_) {
+    throw std::invalid_argument(fmt::format(
+        "broadcast of {} elements exceeds capacity {}", count, capacity_));
+  }
+  if (rank_ == root) {
+    std::copy(data, data + count, slot(root));
+  }
+  barrier();
+  if (rank_ != root) {
+    std::copy(slot(root), slot(root) + count, data);
+  }
+  barrier();
+}
+
+DistributedDataParallel::DistributedDataParallel(ShmCommunicator &comm,
+                                                 FlatParameters parameters)
+    : comm_(comm), parameters_(std::move(parameters)) {}
+
+void DistributedDataParallel::broadcast_parameters(int root) {
+  parameters_.gather_values();
+  comm_.broadcast(parameters_.values(), parameters_.size(), root);
+  parameters_.scatter_values();
+}
+
+void DistributedDataParallel::all_reduce_grads() {
+  parameters_.gather_grads();
+  comm_.all_reduce(parameters_.grads(), parameters_.size());
+  float *grads = parameters_.grads();
+  for (size_t i = 0; i < parameters_.size(); ++i) {
+    grads[i] /= comm_.world_size();
+  }
+  parameters_.scatter_grads();
+}
+
+} // namespace autograd
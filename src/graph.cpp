@@ -0,0 +1,347 @@
+#include "autograd/graph.h"
+
+#include <cstring>
+#include <fmt/format.h>
+#include <fstream>
+#include <stdexcept>
+
+namespace autograd {
+
+GraphView Graph::view() const {
+  GraphView view;
+  view.dtype = dtype_;
+  view.num_nodes = opcodes_.size();
+  view.num_leaves = leaves_.size();
+  view.root = root_;
+  view.opcodes = opcodes_.data();
+  view.edge_offsets = edge_offsets_.data();
+  view.edges = edges_.data();
+  view.saved_offsets = saved_offsets_.data();
+  view.saved = saved_.data();
+  view.leaves = leaves_.data();
+  return view;
+}
+
+void Graph::save(const std::string &path) const {
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  if (!out) {
+    throw std::runtime_error(fmt::format("Cannot open {} for writing", path));
+  }
+  GraphHeader header{};
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+  auto section = [&](const void *data, size_t size) -> uint64_t {
+    static const char zeros[kGraphAlignment] = {};
+    size_t offset = out.tellp();
+    size_t padding = (kGraphAlignment - offset % kGraphAlignment) %
+                     kGraphAlignment;
+    out.write(zeros, padding);
+    out.write(static_cast<const char *>(data), size);
+    return offset + padding;
+  };
+
+  std::memcpy(header.magic, kGraphMagic, sizeof(header.magic));
+  header.version = kGraphVersion;
+  header.dtype = dtype_;
+  header.num_nodes = opcodes_.size();
+  header.num_edges = edges_.size();
+  header.num_saved = saved_.size();
+  header.num_leaves = leaves_.size();
+  header.root = root_;
+  header.opcodes_offset = section(opcodes_.data(), opcodes_.size());
+  header.edge_offsets_offset = section(
+      edge_offsets_.data(), edge_offsets_.size() * sizeof(uint32_t));
+  header.edges_offset =
+      section(edges_.data(), edges_.size() * sizeof(uint32_t));
+  header.saved_offsets_offset = section(
+      saved_offsets_.data(), saved_offsets_.size() * sizeof(uint32_t));
+  header.saved_offset =
+      section(saved_.data(), saved_.size() * sizeof(uint32_t));
+  header.leaves_offset =
+      section(leaves_.data(), leaves_.size() * sizeof(LeafBinding));
+  header.file_size = out.tellp();
+  out.seekp(0);
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  out.close();
+  if (!out) {
+    throw std::runtime_error(fmt::format("Failed writing {}", path));
+  }
+}
+
+MappedGraph::MappedGraph(const std::string &path) : file_(path) {
+  auto corrupt = [&](const char *what) {
+    return std::runtime_error(fmt::format("{}: {}", path, what));
+  };
+  if (file_.size() < sizeof(GraphHeader)) {
+    throw corrupt("not a graph");
+  }
+  auto header = reinterpret_cast<const GraphHeader *>(file_.data());
+  if (std::memcmp(header->magic, kGraphMagic, sizeof(header->magic))) {
+    throw corrupt("not a graph");
+  }
+  if (header->version != kGraphVersion) {
+    throw corrupt("unsupported graph version");
+  }
+  if (header->file_size != file_.size() || header->num_nodes == 0 ||
+      header->root >= header->num_nodes) {
+    throw corrupt("truncated");
+  }
+
+  auto section = [&](uint64_t offset, uint64_t count, size_t size) {
+    if (offset % kGraphAlignment || offset > file_.size() ||
+        count > (file_.size() - offset) / size) {
+      throw corrupt("section out of bounds");
+    }
+    return file_.data() + offset;
+  };
+  uint64_t n = header->num_nodes;
+  view_.dtype = header->dtype;
+  view_.num_nodes = header->num_nodes;
+  view_.num_leaves = header->num_leaves;
+  view_.root = header->root;
+  view_.opcodes = reinterpret_cast<const OpCode *>(
+      section(header->opcodes_offset, n, sizeof(OpCode)));
+  view_.edge_offsets = reinterpret_cast<const uint32_t *>(
+      section(header->edge_offsets_offset, n + 1, sizeof(uint32_t)));
+  view_.edges = reinterpret_cast<const uint32_t *>(
+      section(header->edges_offset, header->num_edges, sizeof(uint32_t)));
+  view_.saved_offsets = reinterpret_cast<const uint32_t *>(
+      section(header->saved_offsets_offset, n + 1, sizeof(uint32_t)));
+  view_.saved = reinterpret_cast<const uint32_t *>(
+      section(header->saved_offset, header->num_saved, sizeof(uint32_t)));
+  view_.leaves = reinterpret_cast<const LeafBinding *>(section(
+      header->leaves_offset, header->num_leaves, sizeof(LeafBinding)));
+
+  // The executors trust the graph, so check every index once here.
+  if (view_.edge_offsets[0] != 0 ||
+      view_.edge_offsets[n] != header->num_edges ||
+      view_.saved_offsets[0] != 0 ||
+      view_.saved_offsets[n] != header->num_saved) {
+    throw corrupt("bad offsets");
+  }
+  for (uint32_t i = 0; i < n; ++i) {
+    auto op = view_.opcodes[i];
+    if ((int)op >= kNumGraphOpCodes) {
+      throw corrupt("bad opcode");
+    }
+    uint32_t begin = view_.edge_offsets[i], end = view_.edge_offsets[i + 1];
+    if (begin > end || end > header->num_edges ||
+        end - begin != (uint32_t)opcode_arity(op)) {
+      throw corrupt("bad edge list");
+    }
+    for (uint32_t e = begin; e < end; ++e) {
+      if (view_.edges[e] >= i) {
+        throw corrupt("edges are not in topological order");
+      }
+    }
+    // The replay reads exactly the saved inputs of the opcode.
+    uint32_t num_saved = opcode_saves_inputs(op) ? opcode_arity(op) : 0;
+    begin = view_.saved_offsets[i], end = view_.saved_offsets[i + 1];
+    if (begin > end || end > header->num_saved || end - begin != num_saved) {
+      throw corrupt("bad saved list");
+    }
+    for (uint32_t s = begin; s < end; ++s) {
+      if (view_.saved[s] >= i) {
+        throw corrupt("saved values are not in topological order");
+      }
+    }
+  }
+  for (uint32_t l = 0; l < view_.num_leaves; ++l) {
+    auto node = view_.leaves[l].node;
+    if (node >= n || view_.opcodes[node] != OpCode::Leaf) {
+      throw corrupt("bad leaf");
+    }
+  }
+}
+
+template <typename T>
+thread_local GraphCapture<T> *GraphCapture<T>::current_ = nullptr;
+
+template <typename T> GraphCapture<T>::GraphCapture() : previous_(current_) {
+  current_ = this;
+}
+
+template <typename T> GraphCapture<T>::~GraphCapture() { stop(); }
+
+template <typename T> GraphCapture<T> *GraphCapture<T>::current() {
+  return current_;
+}
+
+template <typename T> void GraphCapture<T>::stop() {
+  if (!active_) {
+    return;
+  }
+  // Captures finished out of order are unlinked from the middle of the
+  // chain.
+  GraphCapture **link = &current_;
+  while (*link != this) {
+    link = &(*link)->previous_;
+  }
+  *link = previous_;
+  previous_ = nullptr;
+  active_ = false;
+}
+
+template <typename T>
+uint32_t GraphCapture<T>::slot(const std::shared_ptr<BasicVariable<T>> &v) {
+  auto it = slots_.find(v.get());
+  if (it != slots_.end()) {
+    return it->second;
+  }
+  uint32_t slot = records_.size();
+  slots_.emplace(v.get(), slot);
+  variables_.push_back(v);
+  records_.push_back({OpCode::Leaf, {0, 0}});
+  return slot;
+}
+
+template <typename T>
+void GraphCapture<T>::record(OpCode op,
+                             const std::shared_ptr<BasicVariable<T>> &a,
+                             const std::shared_ptr<BasicVariable<T>> &b,
+                             const std::shared_ptr<BasicVariable<T>> &result) {
+  Record record{op, {slot(a), b ? slot(b) : 0}};
+  slots_[result.get()] = records_.size();
+  variables_.push_back(result);
+  records_.push_back(record);
+}
+
+template <typename T>
+Graph GraphCapture<T>::finish(
+    const std::shared_ptr<BasicVariable<T>> &root,
+    std::vector<std::shared_ptr<BasicVariable<T>>> *leaves) {
+  stop();
+  auto it = slots_.find(root.get());
+  if (it == slots_.end()) {
+    throw std::runtime_error("Root was not computed during the capture");
+  }
+
+  // Keep only what the root depends on. Inputs always precede their users,
+  // so one reverse pass marks everything and keeps the numbering
+  // topological.
+  std::vector<uint32_t> renumber(records_.size(), UINT32_MAX);
+  std::vector<bool> needed(records_.size(), false);
+  needed[it->second] = true;
+  for (uint32_t i = it->second + 1; i-- > 0;) {
+    if (!needed[i]) {
+      continue;
+    }
+    for (int k = 0; k < opcode_arity(records_[i].op); ++k) {
+      needed[records_[i].inputs[k]] = true;
+    }
+  }
+
+  Graph graph;
+  graph.dtype_ = scalar_type_of<T>::value;
+  graph.edge_offsets_.push_back(0);
+  graph.saved_offsets_.push_back(0);
+  for (uint32_t i = 0; i <= it->second; ++i) {
+    if (!needed[i]) {
+      continue;
+    }
+    auto &record = records_[i];
+    renumber[i] = graph.opcodes_.size();
+    graph.opcodes_.push_back(record.op);
+    for (int k = 0; k < opcode_arity(record.op); ++k) {
+      graph.edges_.push_back(renumber[record.inputs[k]]);
+      if (opcode_saves_inputs(record.op)) {
+        graph.saved_.push_back(renumber[record.inputs[k]]);
+      }
+    }
+    graph.edge_offsets_.push_back(graph.edges_.size());
+    graph.saved_offsets_.push_back(graph.saved_.size());
+    if (record.op == OpCode::Leaf) {
+      auto &variable = variables_[i];
+      graph.leaves_.push_back({renumber[i], variable->requires_grad(),
+                               static_cast<double>(variable->value_)});
+      if (leaves) {
+        leaves->push_back(variable);
+      }
+    }
+  }
+  graph.root_ = renumber[it->second];
+  return graph;
+}
+
+template <typename T>
+GraphExecutor<T>::GraphExecutor(const GraphView &graph)
+    : graph_(graph), values_(graph.num_nodes), grads_(graph.num_nodes),
+      bindings_(graph.num_leaves) {
+  if (graph.dtype != scalar_type_of<T>::value) {
+    throw std::runtime_error("Graph was captured with a different dtype");
+  }
+}
+
+template <typename T>
+void GraphExecutor<T>::bind(uint32_t leaf,
+                            std::shared_ptr<BasicVariable<T>> variable) {
+  if (leaf >= graph_.num_leaves) {
+    throw std::out_of_range(fmt::format("Graph has no leaf {}", leaf));
+  }
+  bindings_[leaf] = std::move(variable);
+}
+
+template <typename T>
+void GraphExecutor<T>::bind(
+    const std::vector<std::shared_ptr<BasicVariable<T>>> &leaves) {
+  for (size_t i = 0; i < leaves.size(); ++i) {
+    bind(i, leaves[i]);
+  }
+}
+
+template <typename T> acc_type<T> GraphExecutor<T>::forward() {
+  for (uint32_t l = 0; l < graph_.num_leaves; ++l) {
+    auto &leaf = graph_.leaves[l];
+    values_[leaf.node] = bindings_[l] ? A(bindings_[l]->value_)
+                                      : A(T(static_cast<A>(leaf.value)));
+  }
+  for (uint32_t i = 0; i < graph_.num_nodes; ++i) {
+    auto op = graph_.opcodes[i];
+    if (op == OpCode::Leaf) {
+      continue;
+    }
+    const uint32_t *inputs = graph_.edges + graph_.edge_offsets[i];
+    A a = values_[inputs[0]];
+    A b = opcode_arity(op) > 1 ? values_[inputs[1]] : A(0);
+    // Round through the storage type like the eager operators do.
+    values_[i] = A(T(forward_kernel(op, a, b)));
+  }
+  return values_[graph_.root];
+}
+
+template <typename T> void GraphExecutor<T>::backward(A grad) {
+  std::fill(grads_.begin(), grads_.end(), A(0));
+  grads_[graph_.root] = grad;
+  for (uint32_t i = graph_.root + 1; i-- > 0;) {
+    auto op = graph_.opcodes[i];
+    if (op == OpCode::Leaf) {
+      continue;
+    }
+    const uint32_t *inputs = graph_.edges + graph_.edge_offsets[i];
+    const uint32_t *saved = graph_.saved + graph_.saved_offsets[i];
+    uint32_t num_saved = graph_.saved_offsets[i + 1] - graph_.saved_offsets[i];
+    A a = num_saved > 0 ? values_[saved[0]] : A(0);
+    A b = num_saved > 1 ? values_[saved[1]] : A(0);
+    A grad_a = 0, grad_b = 0;
+    backward_kernel(op, a, b, grads_[i], grad_a, grad_b);
+    grads_[inputs[0]] += grad_a;
+    if (opcode_arity(op) > 1) {
+      grads_[inputs[1]] += grad_b;
+    }
+  }
+  for (uint32_t l = 0; l < graph_.num_leaves; ++l) {
+    auto &leaf = graph_.leaves[l];
+    if (bindings_[l] && leaf.requires_grad &&
+        bindings_[l]->requires_grad()) {
+      bindings_[l]->grad_ += grads_[leaf.node];
+    }
+  }
+}
+
+#define INSTANTIATE_GRAPH(T)                                                   \
+  template class GraphCapture<T>;                                              \
+  template class GraphExecutor<T>;
+AUTOGRAD_FORALL_SCALAR_TYPES(INSTANTIATE_GRAPH)
+#undef INSTANTIATE_GRAPH
+
+} // namespace autograd
@@ -0,0 +1,45 @@
+#include "autograd/mapped_file.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fmt/format.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace autograd {
+
+MappedFile::MappedFile(const std::string &path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error(
+        fmt::format("Cannot open {}: {}", path, std::strerror(errno)));
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    throw std::runtime_error(
+        fmt::format("Cannot stat {}: {}", path, std::strerror(errno)));
+  }
+  size_ = st.st_size;
+  if (size_ > 0) {
+    void *data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      close(fd);
+      throw std::runtime_error(
+          fmt::format("Cannot map {}: {}", path, std::strerror(errno)));
+    }
+    data_ = static_cast<const char *>(data);
+  }
+  close(fd);
+}
+
+MappedFile::~MappedFile() {
+  if (data_) {
+    munmap(const_cast<char *>(data_), size_);
+  }
+}
+
+} // namespace autograd
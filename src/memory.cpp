@@ -0,0 +1,141 @@
+#include "autograd/memory.h"
+#include "autograd/variable.h"
+
+#include <atomic>
+
+namespace autograd {
+
+namespace {
+
+// Every thread collects its changes locally and adds them to the shared
+// counters every kFlushInterval changes, so creating a variable or a node
+// does not cost an atomic read-modify-write. The shared counters lag behind
+// by at most that many objects per thread.
+constexpr int kFlushInterval = 64;
+
+enum Counter {
+  // Nodes are counted by opcode, the first kNumOpCodes counters.
+  kVariables = kNumOpCodes,
+  kEdges,
+  kNumCounters,
+};
+
+struct alignas(64) LiveCounter {
+  std::atomic<int64_t> count{0};
+  std::atomic<int64_t> bytes{0};
+  std::atomic<int64_t> peak_count{0};
+  std::atomic<int64_t> peak_bytes{0};
+
+  static void raise(std::atomic<int64_t> &peak, int64_t value) {
+    int64_t current = peak.load(std::memory_order_relaxed);
+    while (value > current &&
+           !peak.compare_exchange_weak(current, value,
+                                       std::memory_order_relaxed)) {
+    }
+  }
+
+  void add(int64_t delta_bytes, int64_t delta_count) {
+    int64_t c =
+        count.fetch_add(delta_count, std::memory_order_relaxed) + delta_count;
+    int64_t b =
+        bytes.fetch_add(delta_bytes, std::memory_order_relaxed) + delta_bytes;
+    raise(peak_count, c);
+    raise(peak_bytes, b);
+  }
+
+  LiveStats load() const {
+    LiveStats stats;
+    stats.count = count.load(std::memory_order_relaxed);
+    stats.bytes = bytes.load(std::memory_order_relaxed);
+    stats.peak_count = peak_count.load(std::memory_order_relaxed);
+    stats.peak_bytes = peak_bytes.load(std::memory_order_relaxed);
+    return stats;
+  }
+
+  void reset_peak() {
+    peak_count = count.load(std::memory_order_relaxed);
+    peak_bytes = bytes.load(std::memory_order_relaxed);
+  }
+};
+
+LiveCounter counters[kNumCounters];
+// All nodes, for the peak over all opcodes.
+LiveCounter nodes;
+
+struct Pending {
+  int64_t count[kNumCounters];
+  int64_t bytes[kNumCounters];
+  int changes;
+};
+
+// Trivially destructible, so objects destroyed after the thread's flusher
+// can still be tracked (and are lost).
+thread_local Pending pending;
+
+void flush() {
+  int64_t node_count = 0, node_bytes = 0;
+  for (int i = 0; i < kNumCounters; ++i) {
+    if (pending.count[i] == 0 && pending.bytes[i] == 0) {
+      continue;
+    }
+    if (i < kNumOpCodes) {
+      node_count += pending.count[i];
+      node_bytes += pending.bytes[i];
+    }
+    counters[i].add(pending.bytes[i], pending.count[i]);
+    pending.count[i] = pending.bytes[i] = 0;
+  }
+  if (node_count != 0 || node_bytes != 0) {
+    nodes.add(node_bytes, node_count);
+  }
+  pending.changes = 0;
+}
+
+struct Flusher {
+  ~Flusher() { flush(); }
+};
+
+void track(int counter, int64_t bytes, int64_t count) {
+  static thread_local Flusher flusher;
+  (void)flusher;
+  pending.count[counter] += count;
+  pending.bytes[counter] += bytes * count;
+  if (++pending.changes == kFlushInterval) {
+    flush();
+  }
+}
+
+} // namespace
+
+void track_node(OpCode op, int64_t bytes, int64_t count) {
+  track((int)op, bytes, count);
+}
+
+void track_variables(int64_t bytes, int64_t count) {
+  track(kVariables, bytes, count);
+}
+
+void track_edges(int64_t count) { track(kEdges, sizeof(Edge), count); }
+
+MemoryStats memory_stats() {
+  // The changes of this thread are exact, the other threads lag behind.
+  flush();
+  MemoryStats stats;
+  stats.nodes = nodes.load();
+  for (int i = 0; i < kNumOpCodes; ++i) {
+    stats.nodes_by_op[i] = counters[i].load();
+  }
+  stats.variables = counters[kVariables].load();
+  stats.edges = counters[kEdges].load();
+  return stats;
+}
+
+void reset_peak_memory_stats() {
+  flush();
+  nodes.reset_peak();
+  for (auto &counter : counters) {
+    counter.reset_peak();
+  }
+}
+
+} // namespace autograd
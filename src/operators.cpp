@@ -1,70 +1,91 @@
 #include "autograd/operators.h"
+#include "autograd/kernels.h"
 #include <cmath>
 
 namespace autograd {
 
-variable_list AccumulateGrad::apply(variable_list &&grads) {
+template <typename T>
+variable_list<T> AccumulateGrad<T>::apply(variable_list<T> &&grads) {
   auto grad = grads[0].value_;
   if (auto ptr = variable_.lock()) {
     ptr->grad_ += grad;
   }
-  return variable_list();
+  return variable_list<T>();
 }
 
-variable_list AddBackward::apply(variable_list &&grads) {
-  auto grad = grads[0].value_;
-  variable_list grads_input{grad, grad};
+template <typename T>
+static variable_list<T> apply_binary(OpCode op, acc_type<T> self,
+                                     acc_type<T> other,
+                                     variable_list<T> &&grads) {
+  acc_type<T> grad_self = 0, grad_other = 0;
+  backward_kernel(op, self, other, grads[0].value_, grad_self, grad_other);
+  variable_list<T> grads_input{grad_self, grad_other};
   return grads_input;
 }
 
-variable_list MulBackward::apply(variable_list &&grads) {
-  auto grad = grads[0].value_;
-  variable_list grads_input{other_->value_ * grad, self_->value_ * grad};
+template <typename T>
+static variable_list<T> apply_unary(OpCode op, acc_type<T> self,
+                                    variable_list<T> &&grads) {
+  acc_type<T> grad_self = 0, unused = 0;
+  backward_kernel(op, self, acc_type<T>(), grads[0].value_, grad_self, unused);
+  variable_list<T> grads_input{grad_self};
   return grads_input;
 }
 
-variable_list DivBackward::apply(variable_list &&grads) {
-  auto grad = grads[0].value_;
-  variable_list grads_input{1.0f / other_->value_ * grad,
-                            -self_->value_ / (other_->value_ * other_->value_) *
-                                grad};
-  return grads_input;
+template <typename T>
+variable_list<T> AddBackward<T>::apply(variable_list<T> &&grads) {
+  return apply_binary<T>(OpCode::Add, 0, 0, std::move(grads));
 }
 
-variable_list SubBackward::apply(variable_list &&grads) {
-  auto grad = grads[0].value_;
-  variable_list grads_input{grad, -grad};
-  return grads_input;
+template <typename T>
+variable_list<T> MulBackward<T>::apply(variable_list<T> &&grads) {
+  return apply_binary<T>(OpCode::Mul, self_->value_, other_->value_,
+                         std::move(grads));
 }
 
-variable_list PowBackward::apply(variable_list &&grads) {
-  auto grad = grads[0].value_;
-  auto xvalue = self_->value_;
-  auto yvalue = other_->value_;
-  variable_list grads_input{grad * yvalue * std::pow(xvalue, yvalue - 1),
-                            grad * std::pow(xvalue, yvalue) * std::log(xvalue)};
-  return grads_input;
+template <typename T>
+variable_list<T> DivBackward<T>::apply(variable_list<T> &&grads) {
+  return apply_binary<T>(OpCode::Div, self_->value_, other_->value_,
+                         std::move(grads));
 }
 
-variable_list LogBackward::apply(variable_list &&grads) {
-  auto grad = grads[0].value_;
-  auto value = self_->value_;
-  variable_list grads_input{grad / value};
-  return grads_input;
+template <typename T>
+variable_list<T> SubBackward<T>::apply(variable_list<T> &&grads) {
+  return apply_binary<T>(OpCode::Sub, 0, 0, std::move(grads));
 }
 
-variable_list ReLUBackward::apply(variable_list &&grads) {
-  auto grad = grads[0].value_;
-  auto value = self_->value_;
-  float grad_value = value >= 0 ? grad : 0.0f;
-  variable_list grads_input{grad_value};
-  return grads_input;
+template <typename T>
+variable_list<T> PowBackward<T>::apply(variable_list<T> &&grads) {
+  return apply_binary<T>(OpCode::Pow, self_->value_, other_->value_,
+                         std::move(grads));
 }
 
-variable_list NegBackward::apply(variable_list &&grads) {
-  auto grad = grads[0].value_;
-  variable_list grads_input{-grad};
-  return grads_input;
+template <typename T>
+variable_list<T> LogBackward<T>::apply(variable_list<T> &&grads) {
+  return apply_unary<T>(OpCode::Log, self_->value_, std::move(grads));
 }
 
+template <typename T>
+variable_list<T> ReLUBackward<T>::apply(variable_list<T> &&grads) {
+  return apply_unary<T>(OpCode::ReLU, self_->value_, std::move(grads));
+}
+
+template <typename T>
+variable_list<T> NegBackward<T>::apply(variable_list<T> &&grads) {
+  return apply_unary<T>(OpCode::Neg, 0, std::move(grads));
+}
+
+#define INSTANTIATE_OPERATORS(T)                                               \
+  template class AccumulateGrad<T>;                                            \
+  template class AddBackward<T>;                                               \
+  template class SubBackward<T>;                                               \
+  template class MulBackward<T>;                                               \
+  template class DivBackward<T>;                                               \
+  template class PowBackward<T>;                                               \
+  template class LogBackward<T>;                                               \
+  template class ReLUBackward<T>;                                              \
+  template class NegBackward<T>;
+AUTOGRAD_FORALL_SCALAR_TYPES(INSTANTIATE_OPERATORS)
+#undef INSTANTIATE_OPERATORS
+
 } // namespace autograd
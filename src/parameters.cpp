@@ -0,0 +1,42 @@
+#include "autograd/parameters.h"
+
+namespace autograd {
+
+FlatParameters::FlatParameters(
+    std::vector<std::shared_ptr<Variable>> parameters) {
+  for (auto &parameter : parameters) {
+    add(parameter);
+  }
+}
+
+void FlatParameters::add(std::shared_ptr<Variable> parameter) {
+  parameters_.push_back(parameter);
+  values_.push_back(parameter->value_);
+  grads_.push_back(parameter->grad_);
+}
+
+void FlatParameters::gather_values() {
+  for (size_t i = 0; i < parameters_.size(); ++i) {
+    values_[i] = parameters_[i]->value_;
+  }
+}
+
+void FlatParameters::scatter_values() {
+  for (size_t i = 0; i < parameters_.size(); ++i) {
+    parameters_[i]->value_ = values_[i];
+  }
+}
+
+void FlatParameters::gather_grads() {
+  for (size_t i = 0; i < parameters_.size(); ++i) {
+    grads_[i] = parameters_[i]->grad_;
+  }
+}
+
+void FlatParameters::scatter_grads() {
+  for (size_t i = 0; i < parameters_.size(); ++i) {
+    parameters_[i]->grad_ = grads_[i];
+  }
+}
+
+} // namespace autograd
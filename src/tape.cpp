@@ -0,0 +1,134 @@
+#include "autograd/tape.h"
+
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+
+namespace autograd {
+
+// Tape ids are never reused, so a slot left on a variable by a cleared or
+// destroyed tape is never mistaken for a slot on the current one.
+static std::atomic<uint32_t> next_tape_id{1};
+
+template <typename T> thread_local Tape<T> *Tape<T>::current_ = nullptr;
+
+template <typename T>
+Tape<T>::Tape() : previous_(current_), id_(next_tape_id++) {
+  current_ = this;
+}
+
+template <typename T> Tape<T>::~Tape() { stop(); }
+
+template <typename T> Tape<T> *Tape<T>::current() { return current_; }
+
+template <typename T> void Tape<T>::stop() {
+  if (!active_) {
+    return;
+  }
+  // Tapes stopped out of order are unlinked from the middle of the chain.
+  Tape **link = &current_;
+  while (*link != this) {
+    link = &(*link)->previous_;
+  }
+  *link = previous_;
+  previous_ = nullptr;
+  active_ = false;
+}
+
+template <typename T> void Tape<T>::clear() {
+  records_.clear();
+  values_.clear();
+  leaves_.clear();
+  foreign_slots_.clear();
+  id_ = next_tape_id++;
+}
+
+template <typename T> Tape<T> *Tape<T>::find(uint32_t id) {
+  for (Tape *tape = current_; tape; tape = tape->previous_) {
+    if (tape->id_ == id) {
+      return tape;
+    }
+  }
+  return nullptr;
+}
+
+template <typename T>
+uint32_t Tape<T>::slot(const std::shared_ptr<BasicVariable<T>> &variable) {
+  if (variable->tape_id_ == id_) {
+    return variable->tape_slot_;
+  }
+  // A slot on a stopped or cleared tape can be taken over, one on an
+  // enclosing tape cannot.
+  bool foreign = variable->tape_id_ != 0 && find(variable->tape_id_);
+  if (foreign) {
+    auto it = foreign_slots_.find(variable.get());
+    if (it != foreign_slots_.end()) {
+      return it->second;
+    }
+  }
+  uint32_t slot = values_.size();
+  values_.push_back(grad_type(variable->value_));
+  leaves_.emplace_back(slot, variable);
+  if (foreign) {
+    foreign_slots_.emplace(variable.get(), slot);
+  } else {
+    variable->tape_id_ = id_;
+    variable->tape_slot_ = slot;
+    variable->tape_output_ = false;
+  }
+  return slot;
+}
+
+template <typename T>
+std::shared_ptr<BasicVariable<T>>
+Tape<T>::record(OpCode op, const std::shared_ptr<BasicVariable<T>> &a,
+                const std::shared_ptr<BasicVariable<T>> &b) {
+  uint32_t lhs = slot(a);
+  uint32_t rhs = b ? slot(b) : kNoSlot;
+  auto result = std::make_shared<BasicVariable<T>>(forward_kernel<grad_type>(
+      op, values_[lhs], rhs != kNoSlot ? values_[rhs] : grad_type(0)));
+  result->tape_id_ = id_;
+  result->tape_slot_ = values_.size();
+  result->tape_output_ = true;
+  // The backward of the graph engine reads the stored (rounded) value.
+  values_.push_back(grad_type(result->value_));
+  records_.push_back({op, {lhs, rhs}, result->tape_slot_});
+  return result;
+}
+
+template <typename T>
+void Tape<T>::backward(const BasicVariable<T> &root, grad_type grad) {
+  if (!contains(root)) {
+    throw std::runtime_error("Variable is not on the tape");
+  }
+  adjoints_.assign(values_.size(), grad_type(0));
+  adjoints_[root.tape_slot_] = grad;
+  // Records after the one producing the root cannot contribute to it.
+  auto end = std::upper_bound(
+      records_.begin(), records_.end(), root.tape_slot_,
+      [](uint32_t slot, const Record &record) { return slot < record.output; });
+  for (auto it = std::make_reverse_iterator(end); it != records_.rend();
+       ++it) {
+    const Record &record = *it;
+    grad_type a = values_[record.inputs[0]];
+    grad_type b =
+        record.inputs[1] != kNoSlot ? values_[record.inputs[1]] : grad_type(0);
+    grad_type grad_a = 0, grad_b = 0;
+    backward_kernel(record.op, a, b, adjoints_[record.output], grad_a, grad_b);
+    adjoints_[record.inputs[0]] += grad_a;
+    if (record.inputs[1] != kNoSlot) {
+      adjoints_[record.inputs[1]] += grad_b;
+    }
+  }
+  for (auto &[slot, leaf] : leaves_) {
+    if (leaf->requires_grad()) {
+      leaf->add_grad(adjoints_[slot]);
+    }
+  }
+}
+
+#define INSTANTIATE_TAPE(T) template class Tape<T>;
+AUTOGRAD_FORALL_SCALAR_TYPES(INSTANTIATE_TAPE)
+#undef INSTANTIATE_TAPE
+
+} // namespace autograd
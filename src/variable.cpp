@@ -1,5 +1,7 @@
 #include "autograd/variable.h"
+#include "autograd/graph.h"
 #include "autograd/operators.h"
+#include "autograd/tape.h"
 
 #include <cmath>
 #include <memory>
@@ -10,121 +12,227 @@ std::shared_ptr<Variable> variable(float v) {
   return std::make_shared<Variable>(v);
 }
 
-void Variable::set_gradient_edge(Edge &&gradient_edge) {
+template <typename T>
+std::shared_ptr<BasicVariable<T>> variable(acc_type<T> v) {
+  return std::make_shared<BasicVariable<T>>(v);
+}
+
+template <typename T>
+static void record(OpCode op, const std::shared_ptr<BasicVariable<T>> &a,
+                   const std::shared_ptr<BasicVariable<T>> &b,
+                   const std::shared_ptr<BasicVariable<T>> &result) {
+  if (auto capture = GraphCapture<T>::current()) {
+    capture->record(op, a, b, result);
+  }
+}
+
+// Operators executed while a tape is active are only appended to it.
+template <typename T>
+static std::shared_ptr<BasicVariable<T>>
+record_on_tape(Tape<T> *tape, OpCode op,
+               const std::shared_ptr<BasicVariable<T>> &a,
+               const std::shared_ptr<BasicVariable<T>> &b) {
+  auto result = tape->record(op, a, b);
+  record<T>(op, a, b, result);
+  return result;
+}
+
+template <typename T>
+void BasicVariable<T>::set_gradient_edge(Edge &&gradient_edge) {
   gradient_edge_ = gradient_edge;
 }
 
-Edge Variable::gradient_edge() {
+template <typename T> Edge BasicVariable<T>::gradient_edge() {
   if (!gradient_edge_.grad_fn() && requires_grad_) {
-    std::shared_ptr<AccumulateGrad> grad_fn =
-        std::make_shared<AccumulateGrad>();
-    grad_fn->variable_ = shared_from_this();
+    std::shared_ptr<AccumulateGrad<T>> grad_fn =
+        std::make_shared<AccumulateGrad<T>>();
+    grad_fn->variable_ = this->shared_from_this();
     grad_fn->add_input_nr();
     gradient_edge_.set_grad_fn(grad_fn);
   }
   return gradient_edge_;
 }
 
-std::shared_ptr<Variable> Variable::detach() {
-  std::shared_ptr<Variable> variable = std::make_shared<Variable>(value_);
+template <typename T>
+std::shared_ptr<BasicVariable<T>> BasicVariable<T>::detach() {
+  std::shared_ptr<BasicVariable> variable =
+      std::make_shared<BasicVariable>(value_);
   variable->requires_grad_ = false;
   return variable;
 }
 
-std::shared_ptr<Variable> operator+(std::shared_ptr<Variable> lhs,
-                                    std::shared_ptr<Variable> rhs) {
-  std::shared_ptr<AddBackward> grad_fn = std::make_shared<AddBackward>();
+template <typename T>
+std::shared_ptr<BasicVariable<T>>
+operator+(std::shared_ptr<BasicVariable<T>> lhs,
+          std::shared_ptr<BasicVariable<T>> rhs) {
+  using A = acc_type<T>;
+  if (auto tape = Tape<T>::current()) {
+    return record_on_tape(tape, OpCode::Add, lhs, rhs);
+  }
+  std::shared_ptr<AddBackward<T>> grad_fn = std::make_shared<AddBackward<T>>();
   grad_fn->add_input_nr();
-  auto result = std::make_shared<Variable>(lhs->value_ + rhs->value_);
+  auto result =
+      std::make_shared<BasicVariable<T>>(A(lhs->value_) + A(rhs->value_));
   result->set_gradient_edge({grad_fn, 0});
   grad_fn->add_next_edge(lhs->gradient_edge());
   grad_fn->add_next_edge(rhs->gradient_edge());
+  record<T>(OpCode::Add, lhs, rhs, result);
   return result;
 }
 
-std::shared_ptr<Variable> operator-(std::shared_ptr<Variable> lhs,
-                                    std::shared_ptr<Variable> rhs) {
-  std::shared_ptr<SubBackward> grad_fn = std::make_shared<SubBackward>();
+template <typename T>
+std::shared_ptr<BasicVariable<T>>
+operator-(std::shared_ptr<BasicVariable<T>> lhs,
+          std::shared_ptr<BasicVariable<T>> rhs) {
+  using A = acc_type<T>;
+  if (auto tape = Tape<T>::current()) {
+    return record_on_tape(tape, OpCode::Sub, lhs, rhs);
+  }
+  std::shared_ptr<SubBackward<T>> grad_fn = std::make_shared<SubBackward<T>>();
   grad_fn->add_input_nr();
-  auto result = std::make_shared<Variable>(lhs->value_ - rhs->value_);
+  auto result =
+      std::make_shared<BasicVariable<T>>(A(lhs->value_) - A(rhs->value_));
   result->set_gradient_edge({grad_fn, 0});
   grad_fn->add_next_edge(lhs->gradient_edge());
   grad_fn->add_next_edge(rhs->gradient_edge());
+  record<T>(OpCode::Sub, lhs, rhs, result);
   return result;
 }
 
-std::shared_ptr<Variable> operator*(std::shared_ptr<Variable> lhs,
-                                    std::shared_ptr<Variable> rhs) {
-  std::shared_ptr<MulBackward> grad_fn = std::make_shared<MulBackward>();
+template <typename T>
+std::shared_ptr<BasicVariable<T>>
+operator*(std::shared_ptr<BasicVariable<T>> lhs,
+          std::shared_ptr<BasicVariable<T>> rhs) {
+  using A = acc_type<T>;
+  if (auto tape = Tape<T>::current()) {
+    return record_on_tape(tape, OpCode::Mul, lhs, rhs);
+  }
+  std::shared_ptr<MulBackward<T>> grad_fn = std::make_shared<MulBackward<T>>();
   grad_fn->self_ = lhs;
   grad_fn->other_ = rhs;
   grad_fn->add_input_nr();
-  auto result = std::make_shared<Variable>(lhs->value_ * rhs->value_);
+  auto result =
+      std::make_shared<BasicVariable<T>>(A(lhs->value_) * A(rhs->value_));
   result->set_gradient_edge({grad_fn, 0});
   grad_fn->add_next_edge(lhs->gradient_edge());
   grad_fn->add_next_edge(rhs->gradient_edge());
+  record<T>(OpCode::Mul, lhs, rhs, result);
   return result;
 }
 
-std::shared_ptr<Variable> operator/(std::shared_ptr<Variable> lhs,
-                                    std::shared_ptr<Variable> rhs) {
-  std::shared_ptr<DivBackward> grad_fn = std::make_shared<DivBackward>();
+template <typename T>
+std::shared_ptr<BasicVariable<T>>
+operator/(std::shared_ptr<BasicVariable<T>> lhs,
+          std::shared_ptr<BasicVariable<T>> rhs) {
+  using A = acc_type<T>;
+  if (auto tape = Tape<T>::current()) {
+    return record_on_tape(tape, OpCode::Div, lhs, rhs);
+  }
+  std::shared_ptr<DivBackward<T>> grad_fn = std::make_shared<DivBackward<T>>();
   grad_fn->self_ = lhs;
   grad_fn->other_ = rhs;
   grad_fn->add_input_nr();
-  auto result = std::make_shared<Variable>(lhs->value_ / rhs->value_);
+  auto result =
+      std::make_shared<BasicVariable<T>>(A(lhs->value_) / A(rhs->value_));
   result->set_gradient_edge({grad_fn, 0});
   grad_fn->add_next_edge(lhs->gradient_edge());
   grad_fn->add_next_edge(rhs->gradient_edge());
+  record<T>(OpCode::Div, lhs, rhs, result);
   return result;
 }
 
-std::shared_ptr<Variable> operator^(std::shared_ptr<Variable> lhs,
-                                    std::shared_ptr<Variable> rhs) {
-  std::shared_ptr<PowBackward> grad_fn = std::make_shared<PowBackward>();
+template <typename T>
+std::shared_ptr<BasicVariable<T>>
+operator^(std::shared_ptr<BasicVariable<T>> lhs,
+          std::shared_ptr<BasicVariable<T>> rhs) {
+  using A = acc_type<T>;
+  if (auto tape = Tape<T>::current()) {
+    return record_on_tape(tape, OpCode::Pow, lhs, rhs);
+  }
+  std::shared_ptr<PowBackward<T>> grad_fn = std::make_shared<PowBackward<T>>();
   grad_fn->self_ = lhs;
   grad_fn->other_ = rhs;
   grad_fn->add_input_nr();
-  auto result = std::make_shared<Variable>(std::pow(lhs->value_, rhs->value_));
+  auto result = std::make_shared<BasicVariable<T>>(
+      std::pow(A(lhs->value_), A(rhs->value_)));
   result->set_gradient_edge({grad_fn, 0});
   grad_fn->add_next_edge(lhs->gradient_edge());
   grad_fn->add_next_edge(rhs->gradient_edge());
+  record<T>(OpCode::Pow, lhs, rhs, result);
   return result;
 }
 
-std::shared_ptr<Variable> Variable::log() {
-  std::shared_ptr<LogBackward> grad_fn = std::make_shared<LogBackward>();
-  grad_fn->self_ = shared_from_this();
+template <typename T>
+std::shared_ptr<BasicVariable<T>> BasicVariable<T>::log() {
+  if (auto tape = Tape<T>::current()) {
+    return record_on_tape(tape, OpCode::Log, this->shared_from_this(), {});
+  }
+  std::shared_ptr<LogBackward<T>> grad_fn = std::make_shared<LogBackward<T>>();
+  grad_fn->self_ = this->shared_from_this();
   grad_fn->add_input_nr();
-  auto result = std::make_shared<Variable>(std::log(value_));
+  auto result = std::make_shared<BasicVariable>(std::log(grad_type(value_)));
   result->set_gradient_edge({grad_fn, 0});
   grad_fn->add_next_edge(gradient_edge());
+  record<T>(OpCode::Log, this->shared_from_this(), nullptr, result);
   return result;
 }
 
-std::shared_ptr<Variable> Variable::relu() {
-  std::shared_ptr<ReLUBackward> grad_fn = std::make_shared<ReLUBackward>();
-  grad_fn->self_ = shared_from_this();
+template <typename T>
+std::shared_ptr<BasicVariable<T>> BasicVariable<T>::relu() {
+  if (auto tape = Tape<T>::current()) {
+    return record_on_tape(tape, OpCode::ReLU, this->shared_from_this(), {});
+  }
+  std::shared_ptr<ReLUBackward<T>> grad_fn =
+      std::make_shared<ReLUBackward<T>>();
+  grad_fn->self_ = this->shared_from_this();
   grad_fn->add_input_nr();
-  auto result = std::make_shared<Variable>(std::max(value_, 0.0f));
+  auto result = std::make_shared<BasicVariable>(
+      std::max(grad_type(value_), grad_type(0)));
   result->set_gradient_edge({grad_fn, 0});
   grad_fn->add_next_edge(gradient_edge());
+  record<T>(OpCode::ReLU, this->shared_from_this(), nullptr, result);
   return result;
 }
 
-std::shared_ptr<Variable> Variable::sigmoid() {
-  auto one = std::make_shared<Variable>(1.0);
-  auto e = std::make_shared<Variable>(std::exp(1.0));
-  return one / (one + (e ^ (-shared_from_this())));
+template <typename T>
+std::shared_ptr<BasicVariable<T>> BasicVariable<T>::sigmoid() {
+  auto one = std::make_shared<BasicVariable>(1.0);
+  auto e = std::make_shared<BasicVariable>(std::exp(1.0));
+  return one / (one + (e ^ (-this->shared_from_this())));
 }
 
-std::shared_ptr<Variable> operator-(std::shared_ptr<Variable> var) {
-  std::shared_ptr<NegBackward> grad_fn = std::make_shared<NegBackward>();
+template <typename T>
+std::shared_ptr<BasicVariable<T>>
+operator-(std::shared_ptr<BasicVariable<T>> var) {
+  using A = acc_type<T>;
+  if (auto tape = Tape<T>::current()) {
+    return record_on_tape(tape, OpCode::Neg, var, {});
+  }
+  std::shared_ptr<NegBackward<T>> grad_fn = std::make_shared<NegBackward<T>>();
   grad_fn->add_input_nr();
-  auto result = std::make_shared<Variable>(-var->value_);
+  auto result = std::make_shared<BasicVariable<T>>(-A(var->value_));
   result->set_gradient_edge({grad_fn, 0});
   grad_fn->add_next_edge(var->gradient_edge());
+  record<T>(OpCode::Neg, var, nullptr, result);
   return result;
 }
 
-} // namespace autograd
\ No newline at end of file
+#define INSTANTIATE_VARIABLE(T)                                                \
+  template class BasicVariable<T>;                                             \
+  template std::shared_ptr<BasicVariable<T>> variable<T>(acc_type<T>);         \
+  template std::shared_ptr<BasicVariable<T>> operator+(                        \
+      std::shared_ptr<BasicVariable<T>>, std::shared_ptr<BasicVariable<T>>);   \
+  template std::shared_ptr<BasicVariable<T>> operator-(                        \
+      std::shared_ptr<BasicVariable<T>>, std::shared_ptr<BasicVariable<T>>);   \
+  template std::shared_ptr<BasicVariable<T>> operator*(                        \
+      std::shared_ptr<BasicVariable<T>>, std::shared_ptr<BasicVariable<T>>);   \
+  template std::shared_ptr<BasicVariable<T>> operator/(                        \
+      std::shared_ptr<BasicVariable<T>>, std::shared_ptr<BasicVariable<T>>);   \
+  template std::shared_ptr<BasicVariable<T>> operator^(                        \
+      std::shared_ptr<BasicVariable<T>>, std::shared_ptr<BasicVariable<T>>);   \
+  template std::shared_ptr<BasicVariable<T>> operator-(                        \
+      std::shared_ptr<BasicVariable<T>>);
+AUTOGRAD_FORALL_SCALAR_TYPES(INSTANTIATE_VARIABLE)
+#undef INSTANTIATE_VARIABLE
+
+} // namespace autograd
@@ -0,0 +1,66 @@
+#include <autograd/array.h>
+#include <autograd/autograd.h>
+#include <autograd/memory.h>
+#include <autograd/variable.h>
+#include <gtest/gtest.h>
+
+using autograd::VariableArray;
+using autograd::variable;
+
+// Reads element i of a strided view.
+template <class T> static T &at(T *base, size_t i) {
+  return *reinterpret_cast<T *>(reinterpret_cast<char *>(base) +
+                                i * VariableArray::stride());
+}
+
+TEST(VariableArray, StridedViews) {
+  float data[] = {1.0f, 2.0f, 3.0f};
+  VariableArray x(data, 3);
+  ASSERT_TRUE(x.contiguous());
+  ASSERT_EQ(&at(x.values(), 2), &x[2]->value_);
+  at(x.values(), 1) = 5.0f;
+  ASSERT_FLOAT_EQ(x[1]->value_, 5.0f);
+
+  auto z = (x * x).sum();
+  ASSERT_FLOAT_EQ(z->value_, 1.0f + 25.0f + 9.0f);
+  autograd::run_backward(*z);
+  for (size_t i = 0; i < 3; ++i) {
+    ASSERT_FLOAT_EQ(at(x.grads(), i), 2 * x[i]->value_);
+  }
+  x.zero_grad();
+  ASSERT_FLOAT_EQ(at(x.grads(), 0), 0.0f);
+}
+
+TEST(VariableArray, ElementwiseOperators) {
+  float xs[] = {0.5f, -1.0f, 2.0f};
+  float ys[] = {4.0f, 3.0f, -1.5f};
+  VariableArray x(xs, 3);
+  VariableArray y(ys, 3);
+  auto w = variable(2.0f);
+  auto out = ((x - y) / w + (-x).relu() * y).sigmoid();
+  ASSERT_FALSE(out.contiguous());
+  ASSERT_EQ(out.size(), 3);
+  for (size_t i = 0; i < 3; ++i) {
+    float expected = (xs[i] - ys[i]) / 2.0f + std::max(-xs[i], 0.0f) * ys[i];
+    ASSERT_FLOAT_EQ(out[i]->value_, 1.0f / (1.0f + std::exp(-expected)));
+  }
+  autograd::run_backward(*(out.sum() + (x + y).log().sum()));
+  ASSERT_NE(w->grad_, 0.0f);
+  ASSERT_THROW(x + VariableArray(xs, 2), std::invalid_argument);
+}
+
+TEST(VariableArray, FreesTheBlock) {
+  auto before = autograd::memory_stats();
+  {
+    float data[] = {1.0f, 2.0f, 3.0f, 4.0f, 5.0f};
+    VariableArray x(data, 5);
+    auto z = (x * x).sum();
+    ASSERT_FLOAT_EQ(z->value_, 55.0f);
+    // ((x0 + x1) + (x2 + x3)) + x4
+    ASSERT_EQ(autograd::graph_stats(*z).depth, 5);
+    autograd::run_backward(*z);
+  }
+  auto after = autograd::memory_stats();
+  ASSERT_EQ(after.variables.count, before.variables.count);
+  ASSERT_EQ(after.nodes.count, before.nodes.count);
+}
@@ -111,6 +111,45 @@ TEST(VariableBackward, StopGradient) {
   ASSERT_FLOAT_EQ(y->grad_, 0.0);
 }
 
+// A node defined outside the library, run through BasicNode::apply.
+class SquareBackward : public autograd::BasicNode<float> {
+public:
+  autograd::variable_list<float>
+  apply(autograd::variable_list<float> &&grads) override {
+    return {Variable(2 * self_->value_ * grads[0].value_)};
+  }
+  std::shared_ptr<Variable> self_;
+};
+
+static std::shared_ptr<Variable> square(std::shared_ptr<Variable> x) {
+  auto grad_fn = std::make_shared<SquareBackward>();
+  grad_fn->self_ = x;
+  grad_fn->add_input_nr();
+  grad_fn->add_next_edge(x->gradient_edge());
+  auto result = variable(x->value_ * x->value_);
+  result->set_gradient_edge({grad_fn, 0});
+  return result;
+}
+
+TEST(VariableBackward, CustomNode) {
+  auto x = variable(3.0);
+  auto y = variable(2.0);
+  auto z = square(x * y) + x;
+  ASSERT_FLOAT_EQ(z->value_, 39.0);
+  autograd::run_backward(*z);
+  ASSERT_FLOAT_EQ(x->grad_, 2 * 6.0 * 2.0 + 1.0);
+  ASSERT_FLOAT_EQ(y->grad_, 2 * 6.0 * 3.0);
+}
+
+TEST(VariableBackward, SharedSubexpression) {
+  auto x = variable(3.0);
+  auto y = x * x;
+  auto z = y * y + y - (-y);
+  autograd::run_backward(*z);
+  // z = x^4 + 2 x^2
+  ASSERT_FLOAT_EQ(x->grad_, 4 * 27.0 + 4 * 3.0);
+}
+
 TEST(VariableForward, sigmoid) {
   auto x = variable(0.0f);
   auto y = x->sigmoid();
@@ -0,0 +1,167 @@
+#include <autograd/autograd.h>
+#include <autograd/checkpoint.h>
+#include <autograd/optimizer.h>
+#include <autograd/variable.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <gtest/gtest.h>
+
+using autograd::Checkpoint;
+using autograd::CheckpointHeader;
+using autograd::CheckpointWriter;
+using autograd::EntryKind;
+using autograd::Variable;
+using autograd::variable;
+
+static std::string temp_path(const char *name) {
+  return testing::TempDir() + name;
+}
+
+TEST(Checkpoint, RoundTrip) {
+  auto path = temp_path("round_trip.ckpt");
+  std::shared_ptr<Variable> layer1[3] = {variable(0.5f), variable(-1.25f),
+                                         variable(3.0f)};
+  std::vector<std::shared_ptr<Variable>> layer2 = {variable(7.0f)};
+  auto z = layer1[0] * layer1[1] + layer1[2] * layer2[0];
+  autograd::run_backward(*z);
+  SGD sgd;
+  sgd.learning_rate_ = 0.25;
+  GradScaler scaler;
+  scaler.scale_ = 512.0f;
+  scaler.growth_tracker_ = 17;
+  {
+    CheckpointWriter writer(path);
+    writer.add_parameters("layer1", layer1);
+    writer.add_parameters("layer2", layer2);
+    writer.add_optimizer("sgd", sgd);
+    writer.add_grad_scaler("scaler", scaler);
+    writer.close();
+  }
+
+  std::shared_ptr<Variable> loaded1[3] = {variable(0.0f), variable(0.0f),
+                                          variable(0.0f)};
+  std::vector<std::shared_ptr<Variable>> loaded2 = {variable(0.0f)};
+  SGD loaded_sgd;
+  GradScaler loaded_scaler;
+  Checkpoint checkpoint(path);
+  ASSERT_EQ(checkpoint.num_entries(), 6);
+  checkpoint.load_parameters("layer1", loaded1);
+  checkpoint.load_parameters("layer2", loaded2);
+  checkpoint.load_optimizer("sgd", loaded_sgd);
+  checkpoint.load_grad_scaler("scaler", loaded_scaler);
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_EQ(loaded1[i]->value_, layer1[i]->value_);
+    ASSERT_EQ(loaded1[i]->grad_, layer1[i]->grad_);
+  }
+  ASSERT_EQ(loaded2[0]->value_, 7.0f);
+  ASSERT_EQ(loaded2[0]->grad_, 3.0f);
+  ASSERT_FLOAT_EQ(loaded_sgd.learning_rate_, 0.25f);
+  ASSERT_FLOAT_EQ(loaded_scaler.scale_, 512.0f);
+  ASSERT_EQ(loaded_scaler.growth_tracker_, 17);
+}
+
+TEST(Checkpoint, ZeroCopyAligned) {
+  auto path = temp_path("aligned.ckpt");
+  std::vector<std::shared_ptr<autograd::HalfVariable>> halves;
+  std::vector<std::shared_ptr<autograd::DoubleVariable>> doubles;
+  for (int i = 0; i < 10000; ++i) {
+    halves.push_back(variable<autograd::half>(i * 0.5f));
+    doubles.push_back(variable<double>(i * 0.1));
+    doubles.back()->grad_ = -i;
+  }
+  {
+    CheckpointWriter writer(path);
+    writer.add_parameters("halves", halves);
+    writer.add_parameters("doubles", doubles);
+  }
+
+  Checkpoint checkpoint(path);
+  for (size_t i = 0; i < checkpoint.num_entries(); ++i) {
+    auto &entry = checkpoint.entry(i);
+    ASSERT_EQ(entry.offset % autograd::kCheckpointAlignment, 0);
+  }
+  auto values = checkpoint.find("halves", EntryKind::Values);
+  ASSERT_NE(values, nullptr);
+  ASSERT_EQ(values->count, 10000);
+  const autograd::half *data = checkpoint.data<autograd::half>(*values);
+  ASSERT_EQ(reinterpret_cast<uintptr_t>(data) % 64, 0);
+  ASSERT_FLOAT_EQ(float(data[1234]), 617.0f);
+  ASSERT_THROW(checkpoint.data<float>(*values), std::runtime_error);
+
+  std::vector<std::shared_ptr<autograd::DoubleVariable>> loaded;
+  for (int i = 0; i < 10000; ++i) {
+    loaded.push_back(variable<double>(0.0));
+  }
+  checkpoint.load_parameters("doubles", loaded);
+  ASSERT_EQ(loaded[9999]->value_, 999.9000000000001);
+  ASSERT_EQ(loaded[9999]->grad_, -9999.0);
+  ASSERT_THROW(checkpoint.load_parameters("halves", loaded),
+               std::runtime_error);
+}
+
+TEST(Checkpoint, RejectsCorruptFiles) {
+  auto path = temp_path("corrupt.ckpt");
+  {
+    std::ofstream out(path, std::ios::binary);
+    out << "definitely not a checkpoint, but long enough to hold a header";
+  }
+  ASSERT_THROW(Checkpoint checkpoint(path), std::runtime_error);
+
+  std::vector<std::shared_ptr<Variable>> parameters = {variable(1.0f)};
+  {
+    CheckpointWriter writer(path);
+    writer.add_parameters("p", parameters);
+  }
+  std::string contents;
+  {
+    std::ifstream in(path, std::ios::binary);
+    contents.assign(std::istreambuf_iterator<char>(in), {});
+  }
+  {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(contents.data(), contents.size() - 1);
+  }
+  ASSERT_THROW(Checkpoint checkpoint(path), std::runtime_error);
+
+  // A zero or misaligned alignment in the header.
+  for (uint32_t alignment : {0u, 4u, 48u}) {
+    auto corrupt = contents;
+    std::memcpy(&corrupt[offsetof(CheckpointHeader, alignment)], &alignment,
+                sizeof(alignment));
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << corrupt;
+    ASSERT_THROW(Checkpoint checkpoint(path), std::runtime_error);
+  }
+  ASSERT_THROW(Checkpoint checkpoint(temp_path("missing.ckpt")),
+               std::runtime_error);
+}
+
+TEST(Checkpoint, RejectsDuplicateEntries) {
+  auto path = temp_path("duplicate.ckpt");
+  std::vector<std::shared_ptr<Variable>> parameters = {variable(1.0f)};
+  {
+    CheckpointWriter writer(path);
+    writer.add_parameters("a", parameters);
+    ASSERT_THROW(writer.add_parameters("a", parameters),
+                 std::invalid_argument);
+    writer.add_parameters("b", parameters);
+  }
+  ASSERT_NO_THROW(Checkpoint checkpoint(path));
+
+  // Rename the values of b to a.
+  std::string contents;
+  {
+    std::ifstream in(path, std::ios::binary);
+    contents.assign(std::istreambuf_iterator<char>(in), {});
+  }
+  CheckpointHeader header;
+  std::memcpy(&header, contents.data(), sizeof(header));
+  auto entries = reinterpret_cast<autograd::CheckpointEntry *>(
+      &contents[header.index_offset]);
+  ASSERT_EQ(header.num_entries, 4);
+  ASSERT_STREQ(entries[2].name, "b");
+  entries[2].name[0] = 'a';
+  std::ofstream(path, std::ios::binary | std::ios::trunc) << contents;
+  ASSERT_THROW(Checkpoint checkpoint(path), std::runtime_error);
+}
@@ -0,0 +1,175 @@
+#include <autograd/autograd.h>
+#include <autograd/data.h>
+#include <autograd/memory.h>
+#include <autograd/variable.h>
+#include <algorithm>
+#include <fstream>
+#include <gtest/gtest.h>
+
+using autograd::BinaryDataset;
+using autograd::CsvDataset;
+using autograd::DataLoader;
+using autograd::DataLoaderOptions;
+using autograd::SpscQueue;
+
+static std::string temp_path(const char *name) {
+  return testing::TempDir() + name;
+}
+
+// Rows (i, 2 * i) for i in [0, rows).
+static std::shared_ptr<BinaryDataset> make_binary(const char *name,
+                                                  int rows) {
+  auto path = temp_path(name);
+  std::ofstream out(path, std::ios::binary);
+  for (int i = 0; i < rows; ++i) {
+    float row[2] = {float(i), 2.0f * i};
+    out.write(reinterpret_cast<const char *>(row), sizeof(row));
+  }
+  out.close();
+  return std::make_shared<BinaryDataset>(path, 2);
+}
+
+// Returns the first column of every row, in the order they were loaded.
+static std::vector<float> load_all(DataLoader &loader,
+                                   std::vector<size_t> *sizes = nullptr) {
+  std::vector<float> firsts;
+  while (auto batch = loader.next()) {
+    if (sizes) {
+      sizes->push_back(batch->rows());
+    }
+    for (size_t r = 0; r < batch->rows(); ++r) {
+      EXPECT_EQ((*batch)(r, 1)->value_, 2.0f * (*batch)(r, 0)->value_);
+      firsts.push_back((*batch)(r, 0)->value_);
+    }
+  }
+  return firsts;
+}
+
+TEST(SpscQueue, Bounded) {
+  SpscQueue<int> queue(2);
+  int value = 0;
+  ASSERT_FALSE(queue.pop(value));
+  ASSERT_TRUE(queue.push(1));
+  ASSERT_TRUE(queue.push(2));
+  ASSERT_FALSE(queue.push(3));
+  ASSERT_TRUE(queue.pop(value));
+  ASSERT_EQ(value, 1);
+  ASSERT_TRUE(queue.push(3));
+  ASSERT_TRUE(queue.pop(value));
+  ASSERT_EQ(value, 2);
+  ASSERT_TRUE(queue.pop(value));
+  ASSERT_EQ(value, 3);
+  ASSERT_FALSE(queue.pop(value));
+}
+
+TEST(DataLoader, SequentialBatches) {
+  auto dataset = make_binary("sequential.bin", 10);
+  ASSERT_EQ(dataset->size(), 10);
+  DataLoaderOptions options;
+  options.batch_size = 4;
+  options.prefetch = 1;
+  DataLoader loader(dataset, options);
+  std::vector<size_t> sizes;
+  auto firsts = load_all(loader, &sizes);
+  ASSERT_EQ(sizes, (std::vector<size_t>{4, 4, 2}));
+  for (int i = 0; i < 10; ++i) {
+    ASSERT_EQ(firsts[i], float(i));
+  }
+  ASSERT_EQ(loader.next(), nullptr);
+}
+
+TEST(DataLoader, ShuffleIsAPermutation) {
+  auto dataset = make_binary("shuffle.bin", 100);
+  DataLoaderOptions options;
+  options.batch_size = 8;
+  options.shuffle_buffer = 16;
+  options.drop_last = true;
+  options.seed = 42;
+  DataLoader loader(dataset, options);
+  auto firsts = load_all(loader);
+  ASSERT_EQ(firsts.size(), 96);
+  ASSERT_FALSE(std::is_sorted(firsts.begin(), firsts.end()));
+  std::sort(firsts.begin(), firsts.end());
+  ASSERT_EQ(std::unique(firsts.begin(), firsts.end()), firsts.end());
+
+  options.drop_last = false;
+  DataLoader full(dataset, options);
+  firsts = load_all(full);
+  std::sort(firsts.begin(), firsts.end());
+  for (int i = 0; i < 100; ++i) {
+    ASSERT_EQ(firsts[i], float(i));
+  }
+}
+
+TEST(DataLoader, BatchesAreConstants) {
+  auto dataset = make_binary("constants.bin", 4);
+  DataLoader loader(dataset);
+  auto batch = loader.next();
+  ASSERT_EQ(batch->rows(), 4);
+  auto w = autograd::variable(3.0f);
+  auto loss = w * (*batch)(1, 0) + (*batch)(2, 1);
+  autograd::run_backward(*loss);
+  ASSERT_FLOAT_EQ(w->grad_, 1.0f);
+  ASSERT_FALSE((*batch)(1, 0)->requires_grad());
+  ASSERT_EQ((*batch)(1, 0)->grad_, 0.0f);
+}
+
+TEST(DataLoader, StopsEarly) {
+  auto dataset = make_binary("early.bin", 1000);
+  DataLoaderOptions options;
+  options.batch_size = 1;
+  options.prefetch = 2;
+  DataLoader loader(dataset, options);
+  ASSERT_EQ(loader.next()->rows(), 1);
+}
+
+TEST(DataLoader, FreesBatches) {
+  auto dataset = make_binary("frees.bin", 100);
+  auto before = autograd::memory_stats();
+  {
+    DataLoaderOptions options;
+    options.batch_size = 8;
+    options.prefetch = 2;
+    DataLoader loader(dataset, options);
+    ASSERT_EQ(load_all(loader).size(), 100);
+    DataLoader early(dataset, options);
+    ASSERT_NE(early.next(), nullptr);
+  }
+  ASSERT_EQ(autograd::memory_stats().variables.count,
+            before.variables.count);
+}
+
+TEST(CsvDataset, Parse) {
+  auto path = temp_path("data.csv");
+  std::ofstream(path) << "x,y\n0, 0\r\n1,2\n\n2.5,5e0\n";
+  auto dataset = std::make_shared<CsvDataset>(path, true);
+  ASSERT_EQ(dataset->size(), 3);
+  ASSERT_EQ(dataset->width(), 2);
+  DataLoader loader(dataset);
+  auto firsts = load_all(loader);
+  ASSERT_EQ(firsts, (std::vector<float>{0.0f, 1.0f, 2.5f}));
+}
+
+TEST(CsvDataset, ErrorsReachTheTrainingThread) {
+  auto path = temp_path("bad.csv");
+  std::ofstream(path) << "1,2\n3,x\n";
+  DataLoaderOptions options;
+  options.batch_size = 1;
+  DataLoader loader(std::make_shared<CsvDataset>(path), options);
+  ASSERT_NE(loader.next(), nullptr);
+  ASSERT_THROW(loader.next(), std::runtime_error);
+  ASSERT_EQ(loader.next(), nullptr);
+}
+
+TEST(CsvDataset, RejectsLongFields) {
+  auto path = temp_path("long.csv");
+  std::ofstream(path) << "1," << std::string(100, '1') << "\n";
+  DataLoader loader(std::make_shared<CsvDataset>(path));
+  ASSERT_THROW(loader.next(), std::runtime_error);
+}
+
+TEST(BinaryDataset, RejectsPartialRows) {
+  auto path = temp_path("partial.bin");
+  std::ofstream(path, std::ios::binary) << "abcdef";
+  ASSERT_THROW(BinaryDataset(path, 1), std::runtime_error);
+}
@@ -0,0 +1,162 @@
+#include <autograd/autograd.h>
+#include <autograd/distributed.h>
+#include <autograd/optimizer.h>
+#include <autograd/variable.h>
+#include <cstring>
+#include <fmt/format.h>
+#include <functional>
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using autograd::DistributedDataParallel;
+using autograd::FlatParameters;
+using autograd::ShmCommunicator;
+using autograd::Variable;
+using autograd::variable;
+
+// Runs `fn(rank)` in `world_size` forked processes and returns true if all of
+// them exited cleanly.
+static bool run_ranks(int world_size, std::function<void(int)> fn) {
+  std::vector<pid_t> children;
+  for (int rank = 0; rank < world_size; ++rank) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      try {
+        fn(rank);
+      } catch (std::exception &e) {
+        fmt::print(stderr, "rank {}: {}\n", rank, e.what());
+        _exit(1);
+      }
+      _exit(0);
+    }
+    children.push_back(pid);
+  }
+  bool ok = true;
+  for (pid_t pid : children) {
+    int status = 0;
+    waitpid(pid, &status, 0);
+    ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  }
+  return ok;
+}
+
+template <class T> static T *shared_array(size_t n) {
+  void *p = mmap(nullptr, sizeof(T) * n, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  return static_cast<T *>(p);
+}
+
+static std::string shm_name(const char *test) {
+  return fmt::format("/autograd_test_{}_{}", test, getpid());
+}
+
+TEST(ShmCommunicator, AllReduce) {
+  const int world_size = 4;
+  const size_t count = 10;
+  float *results = shared_array<float>(world_size * count);
+  auto name = shm_name("all_reduce");
+  ASSERT_TRUE(run_ranks(world_size, [&](int rank) {
+    ShmCommunicator comm(name, rank, world_size, count);
+    float data[count];
+    for (size_t i = 0; i < count; ++i) {
+      data[i] = rank * 100 + i;
+    }
+    comm.all_reduce(data, count);
+    std::memcpy(results + rank * count, data, sizeof(data));
+  }));
+  for (int rank = 0; rank < world_size; ++rank) {
+    for (size_t i = 0; i < count; ++i) {
+      ASSERT_FLOAT_EQ(results[rank * count + i], 600 + 4 * i);
+    }
+  }
+  munmap(results, sizeof(float) * world_size * count);
+}
+
+TEST(ShmCommunicator, Broadcast) {
+  const int world_size = 3;
+  float *results = shared_array<float>(world_size);
+  auto name = shm_name("broadcast");
+  ASSERT_TRUE(run_ranks(world_size, [&](int rank) {
+    ShmCommunicator comm(name, rank, world_size, 1);
+    float value = rank == 1 ? 42.0f : -1.0f;
+    comm.broadcast(&value, 1, 1);
+    results[rank] = value;
+  }));
+  for (int rank = 0; rank < world_size; ++rank) {
+    ASSERT_FLOAT_EQ(results[rank], 42.0f);
+  }
+  munmap(results, sizeof(float) * world_size);
+}
+
+TEST(ShmCommunicator, IgnoresStaleSegments) {
+  const int world_size = 3;
+  float *results = shared_array<float>(world_size);
+  auto name = shm_name("stale");
+  // The header of a run that crashed after everyone had attached: magic,
+  // world size, capacity, all tickets taken and marked ready.
+  int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0600);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(ftruncate(fd, 4096), 0);
+  uint32_t stale[6] = {0x41475348, world_size, 1, 0, world_size - 1, 1};
+  ASSERT_EQ(write(fd, stale, sizeof(stale)), (ssize_t)sizeof(stale));
+  close(fd);
+  ASSERT_TRUE(run_ranks(world_size, [&](int rank) {
+    if (rank == 0) {
+      usleep(100000);
+    }
+    ShmCommunicator comm(name, rank, world_size, 1);
+    float value = rank + 1.0f;
+    comm.all_reduce(&value, 1);
+    results[rank] = value;
+  }));
+  for (int rank = 0; rank < world_size; ++rank) {
+    ASSERT_FLOAT_EQ(results[rank], 6.0f);
+  }
+  munmap(results, sizeof(float) * world_size);
+}
+
+TEST(DistributedDataParallel, IdenticalParameters) {
+  const int world_size = 4;
+  const int steps = 200;
+  float *results = shared_array<float>(world_size * 2);
+  auto name = shm_name("ddp");
+  ASSERT_TRUE(run_ranks(world_size, [&](int rank) {
+    // Every rank starts from different weights; broadcast_parameters makes
+    // them agree before training.
+    auto w = variable(0.1f * rank);
+    auto b = variable(-0.2f * rank);
+    ShmCommunicator comm(name, rank, world_size, 2);
+    DistributedDataParallel ddp(comm, FlatParameters({w, b}));
+    ddp.broadcast_parameters();
+
+    // y = 2x + 1, each rank sees its own shard of x.
+    SGD sgd;
+    sgd.learning_rate_ = 0.01;
+    for (int i = 0; i < steps; ++i) {
+      zero_grad(ddp.parameters());
+      auto loss = variable(0.0f);
+      for (int k = 0; k < 4; ++k) {
+        auto x = variable(0.25f * (rank * 4 + k));
+        auto y = variable(2.0f * x->value_ + 1.0f);
+        x->set_requires_grad(false);
+        y->set_requires_grad(false);
+        auto diff = w * x + b - y;
+        loss = loss + diff * diff;
+      }
+      autograd::run_backward(*loss);
+      ddp.all_reduce_grads();
+      sgd.step(ddp.parameters());
+    }
+    results[rank * 2] = w->value_;
+    results[rank * 2 + 1] = b->value_;
+  }));
+  for (int rank = 1; rank < world_size; ++rank) {
+    ASSERT_EQ(std::memcmp(results, results + rank * 2, sizeof(float) * 2), 0);
+  }
+  ASSERT_NEAR(results[0], 2.0, 0.1);
+  ASSERT_NEAR(results[1], 1.0, 0.1);
+  munmap(results, sizeof(float) * world_size * 2);
+}
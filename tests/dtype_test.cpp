@@ -0,0 +1,124 @@
+#include <autograd/autograd.h>
+#include <autograd/optimizer.h>
+#include <autograd/variable.h>
+#include <cmath>
+#include <gtest/gtest.h>
+#include <limits>
+
+using autograd::bfloat16;
+using autograd::BFloat16Variable;
+using autograd::DoubleVariable;
+using autograd::half;
+using autograd::HalfVariable;
+using autograd::variable;
+
+TEST(Half, Conversion) {
+  ASSERT_EQ(half(1.0f).bits, 0x3c00);
+  ASSERT_EQ(half(-2.0f).bits, 0xc000);
+  ASSERT_EQ(half(-0.0f).bits, 0x8000);
+  ASSERT_EQ(half(65504.0f).bits, 0x7bff);
+  ASSERT_EQ(half(65520.0f).bits, 0x7c00);
+  ASSERT_EQ(half(std::ldexp(1.0f, -24)).bits, 0x0001);
+  ASSERT_EQ(half(std::ldexp(1.0f, -14)).bits, 0x0400);
+  // Ties round to even.
+  ASSERT_EQ(half(1.0f + std::ldexp(1.0f, -11)).bits, 0x3c00);
+  ASSERT_EQ(half(1.0f + 3 * std::ldexp(1.0f, -11)).bits, 0x3c02);
+  ASSERT_TRUE(std::isnan(float(half(std::nanf("")))));
+  ASSERT_TRUE(std::isinf(float(half(std::numeric_limits<float>::infinity()))));
+  ASSERT_FLOAT_EQ(float(half(0.333333f)), 0.33325195f);
+  ASSERT_FLOAT_EQ(float(half(std::ldexp(1.0f, -20))), std::ldexp(1.0f, -20));
+}
+
+TEST(BFloat16, Conversion) {
+  ASSERT_EQ(bfloat16(1.0f).bits, 0x3f80);
+  ASSERT_EQ(bfloat16(-2.0f).bits, 0xc000);
+  ASSERT_EQ(bfloat16(1.0f + std::ldexp(1.0f, -8)).bits, 0x3f80);
+  ASSERT_EQ(bfloat16(1.0f + 3 * std::ldexp(1.0f, -8)).bits, 0x3f82);
+  ASSERT_NEAR(float(bfloat16(3.0e38f)), 3.0e38f, 3.0e38f / 256);
+  ASSERT_TRUE(std::isnan(float(bfloat16(std::nanf("")))));
+}
+
+TEST(Double, GradientCheck) {
+  auto f = [](double xv, double yv) {
+    auto x = variable<double>(xv);
+    auto y = variable<double>(yv);
+    auto z = (x * y + (x ^ y))->log() / (x - y) + (-x)->sigmoid();
+    return std::make_tuple(x, y, z);
+  };
+  const double xv = 1.7, yv = 0.6, h = 1e-6;
+  auto [x, y, z] = f(xv, yv);
+  autograd::run_backward(*z);
+  double dx = (std::get<2>(f(xv + h, yv))->value_ -
+               std::get<2>(f(xv - h, yv))->value_) /
+              (2 * h);
+  double dy = (std::get<2>(f(xv, yv + h))->value_ -
+               std::get<2>(f(xv, yv - h))->value_) /
+              (2 * h);
+  ASSERT_NEAR(x->grad_, dx, 1e-8);
+  ASSERT_NEAR(y->grad_, dy, 1e-8);
+}
+
+TEST(Half, AccumulatesInFloat) {
+  static_assert(std::is_same<HalfVariable::grad_type, float>::value, "");
+  static_assert(sizeof(half) == 2 && sizeof(bfloat16) == 2, "");
+  auto x = variable<half>(1.0f);
+  auto c = variable<half>(1e-4f);
+  c->set_requires_grad(false);
+  auto z = x * c;
+  for (int i = 1; i < 2048; ++i) {
+    z = z + x * c;
+  }
+  autograd::run_backward(*z);
+  // Summed in half, the grad would stall long before 2048 * c.
+  ASSERT_NEAR(x->grad_, 2048 * float(c->value_), 1e-5);
+}
+
+TEST(GradScaler, SkipsOverflow) {
+  auto w = variable<half>(3.0f);
+  auto x = variable<half>(1000.0f);
+  x->set_requires_grad(false);
+  auto loss = w * x;
+
+  SGD sgd;
+  GradScaler scaler;
+  scaler.scale_ = 1e36f;
+  autograd::run_backward(*loss, scaler.scale_);
+  ASSERT_FALSE(scaler.step(sgd, w));
+  ASSERT_FLOAT_EQ(float(w->value_), 3.0f);
+  ASSERT_FLOAT_EQ(scaler.scale_, 5e35f);
+
+  w->zero_grad();
+  scaler.scale_ = 1024.0f;
+  autograd::run_backward(*loss, scaler.scale_);
+  ASSERT_TRUE(scaler.step(sgd, w));
+  ASSERT_FLOAT_EQ(w->grad_, 1000.0f);
+  ASSERT_FLOAT_EQ(float(w->value_),
+                  float(half(3.0f - sgd.learning_rate_ * 1000.0f)));
+}
+
+TEST(Integration, BFloat16LinearRegression) {
+  auto w = variable<bfloat16>(0.128911248f);
+  auto b = variable<bfloat16>(-0.423790183f);
+
+  // y = x + 1
+  SGD sgd;
+  GradScaler scaler;
+  sgd.learning_rate_ = 0.5;
+  for (int i = 0; i < 1000; ++i) {
+    zero_grad(w, b);
+    auto z = variable<bfloat16>(0.0f);
+    for (float xv = 0.0; xv < 1.0; xv += 0.125) {
+      auto x = variable<bfloat16>(xv);
+      auto y = variable<bfloat16>(xv + 1.0f);
+      x->set_requires_grad(false);
+      y->set_requires_grad(false);
+      auto diff = w * x + b - y;
+      z = z + diff * diff;
+    }
+    z = z / variable<bfloat16>(8.0f);
+    autograd::run_backward(*z, scaler.scale_);
+    scaler.step(sgd, w, b);
+  }
+  ASSERT_NEAR(float(w->value_), 1.0, 5e-2);
+  ASSERT_NEAR(float(b->value_), 1.0, 5e-2);
+}
@@ -0,0 +1,130 @@
+#include <autograd/autograd.h>
+#include <autograd/variable.h>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <sstream>
+#include <unistd.h>
+
+using autograd::GraphExportOptions;
+using autograd::OpCode;
+using autograd::variable;
+
+static std::string export_dot(autograd::Variable &root,
+                              const GraphExportOptions &options = {}) {
+  std::ostringstream out;
+  autograd::export_graph(root, out, options);
+  return out.str();
+}
+
+TEST(ExportGraph, Dot) {
+  auto x = variable(2.0f);
+  auto y = variable(3.0f);
+  auto z = x * y + x;
+  ASSERT_EQ(export_dot(*z), "digraph {\n"
+                            "  0 [label=\"Add\"]\n"
+                            "  0 -> {1 2}\n"
+                            "  1 [label=\"Mul\"]\n"
+                            "  1 -> {2 3}\n"
+                            "  2 [label=\"AccumulateGrad\"]\n"
+                            "  3 [label=\"AccumulateGrad\"]\n"
+                            "}\n");
+}
+
+TEST(ExportGraph, Limits) {
+  auto x = variable(2.0f);
+  auto y = variable(3.0f);
+  auto z = x * y + x;
+  GraphExportOptions options;
+  options.max_depth = 2;
+  ASSERT_EQ(export_dot(*z, options), "digraph {\n"
+                                     "  0 [label=\"Add\"]\n"
+                                     "  0 -> {1 2}\n"
+                                     "  1 [label=\"Mul\"]\n"
+                                     "  1 -> {2}\n"
+                                     "  2 [label=\"AccumulateGrad\"]\n"
+                                     "}\n");
+  options = {};
+  options.max_nodes = 2;
+  ASSERT_EQ(export_dot(*z, options), "digraph {\n"
+                                     "  0 [label=\"Add\"]\n"
+                                     "  0 -> {1}\n"
+                                     "  1 [label=\"Mul\"]\n"
+                                     "}\n");
+}
+
+TEST(ExportGraph, EdgeList) {
+  auto x = variable(2.0f);
+  auto z = -(x * x);
+  GraphExportOptions options;
+  options.format = GraphExportOptions::Format::EdgeList;
+  std::ostringstream out;
+  ASSERT_EQ(autograd::export_graph(*z, out, options), 3);
+  std::string data = out.str();
+
+  autograd::EdgeListHeader header;
+  ASSERT_GE(data.size(), sizeof(header));
+  std::memcpy(&header, data.data(), sizeof(header));
+  ASSERT_EQ(std::memcmp(header.magic, autograd::kEdgeListMagic, 8), 0);
+  ASSERT_EQ(header.version, autograd::kEdgeListVersion);
+
+  std::istringstream in(data.substr(sizeof(header)));
+  auto read_node = [&](OpCode op, std::vector<uint32_t> targets) {
+    OpCode read_op;
+    uint32_t count;
+    in.read(reinterpret_cast<char *>(&read_op), sizeof(read_op));
+    in.read(reinterpret_cast<char *>(&count), sizeof(count));
+    ASSERT_EQ(read_op, op);
+    ASSERT_EQ(count, targets.size());
+    for (uint32_t target : targets) {
+      uint32_t read_target;
+      in.read(reinterpret_cast<char *>(&read_target), sizeof(read_target));
+      ASSERT_EQ(read_target, target);
+    }
+  };
+  read_node(OpCode::Neg, {1});
+  read_node(OpCode::Mul, {2, 2});
+  read_node(OpCode::AccumulateGrad, {});
+  ASSERT_EQ(in.peek(), EOF);
+}
+
+TEST(ExportGraph, FileDescriptor) {
+  // A balanced sum, large enough to go through several buffer flushes.
+  auto x = variable(2.0f);
+  std::vector<std::shared_ptr<autograd::Variable>> level;
+  for (int i = 0; i < 8192; ++i) {
+    level.push_back(x * variable(float(i))->detach());
+  }
+  while (level.size() > 1) {
+    std::vector<std::shared_ptr<autograd::Variable>> next;
+    for (size_t i = 0; i < level.size(); i += 2) {
+      next.push_back(level[i] + level[i + 1]);
+    }
+    level = std::move(next);
+  }
+  auto y = level[0];
+  auto path = testing::TempDir() + "graph.dot";
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(autograd::export_graph(y->gradient_edge().grad_fn(), fd), 16384);
+  close(fd);
+  std::ifstream in(path);
+  std::string written((std::istreambuf_iterator<char>(in)),
+                      std::istreambuf_iterator<char>());
+  ASSERT_EQ(written, export_dot(*y));
+}
+
+class ScaleBackward : public autograd::BasicNode<float> {
+public:
+  autograd::variable_list<float>
+  apply(autograd::variable_list<float> &&grads) override {
+    return grads;
+  }
+};
+
+TEST(ExportGraph, CustomNodeNames) {
+  std::ostringstream out;
+  autograd::export_graph(std::make_shared<ScaleBackward>(), out);
+  ASSERT_EQ(out.str(), "digraph {\n  0 [label=\"ScaleBackward\"]\n}\n");
+}
@@ -0,0 +1,143 @@
+#include <autograd/autograd.h>
+#include <autograd/graph.h>
+#include <autograd/variable.h>
+#include <fstream>
+#include <gtest/gtest.h>
+
+#include "small_model.h"
+
+using autograd::Graph;
+using autograd::GraphCapture;
+using autograd::GraphExecutor;
+using autograd::MappedGraph;
+using autograd::OpCode;
+using autograd::Variable;
+using autograd::variable;
+
+TEST(GraphCapture, ReplayMatchesEager) {
+  auto w = make_parameters(0.1f);
+  Parameters leaves;
+  GraphCapture<float> capture;
+  auto loss = forward(w, 1.0f, 0.0f, 1.0f);
+  Graph graph = capture.finish(loss, &leaves);
+  autograd::run_backward(*loss);
+
+  GraphExecutor<float> executor(graph.view());
+  auto replayed = make_parameters(0.1f);
+  // Leaves are numbered in order of first use; map them back to the fresh
+  // parameters, everything else keeps its captured value.
+  for (size_t l = 0; l < leaves.size(); ++l) {
+    for (size_t k = 0; k < w.size(); ++k) {
+      if (leaves[l] == w[k]) {
+        executor.bind(l, replayed[k]);
+      }
+    }
+  }
+  ASSERT_EQ(executor.forward(), loss->value_);
+  executor.backward();
+  for (size_t k = 0; k < w.size(); ++k) {
+    ASSERT_FLOAT_EQ(replayed[k]->grad_, w[k]->grad_) << k;
+  }
+}
+
+TEST(GraphCapture, PrunesUnusedNodes) {
+  auto x = variable(2.0f);
+  auto y = variable(3.0f);
+  GraphCapture<float> capture;
+  auto unused = x * y;
+  auto z = x + y;
+  Graph graph = capture.finish(z);
+  ASSERT_EQ(graph.opcodes_.size(), 3);
+  ASSERT_EQ(graph.opcodes_[graph.root_], OpCode::Add);
+  ASSERT_EQ(graph.leaves_.size(), 2);
+  ASSERT_EQ(GraphCapture<float>::current(), nullptr);
+  ASSERT_THROW(capture.finish(variable(1.0f)), std::runtime_error);
+}
+
+TEST(GraphCapture, FinishOutOfOrder) {
+  auto x = variable(2.0f);
+  auto outer = std::make_unique<GraphCapture<float>>();
+  auto z = x * x;
+  GraphCapture<float> inner;
+  ASSERT_EQ(outer->finish(z).opcodes_.size(), 2);
+  outer.reset();
+  ASSERT_EQ(GraphCapture<float>::current(), &inner);
+  auto y = x + z;
+  // z was computed before the inner capture, it is a leaf there.
+  ASSERT_EQ(inner.finish(y).opcodes_.size(), 3);
+  ASSERT_EQ(GraphCapture<float>::current(), nullptr);
+}
+
+TEST(MappedGraph, SaveLoadReplay) {
+  auto path = testing::TempDir() + "xor.graph";
+  auto w = make_parameters(0.2f);
+  Parameters leaves;
+  {
+    GraphCapture<float> capture;
+    auto loss = forward(w, 0.0f, 1.0f, 1.0f);
+    capture.finish(loss, &leaves).save(path);
+  }
+
+  // A different set of weights, evaluated eagerly and through the graph.
+  auto eager = make_parameters(-0.3f);
+  auto loss = forward(eager, 0.0f, 1.0f, 1.0f);
+  autograd::run_backward(*loss);
+
+  MappedGraph graph(path);
+  GraphExecutor<float> executor(graph.view());
+  auto replayed = make_parameters(-0.3f);
+  for (size_t l = 0; l < leaves.size(); ++l) {
+    for (size_t k = 0; k < w.size(); ++k) {
+      if (leaves[l] == w[k]) {
+        executor.bind(l, replayed[k]);
+      }
+    }
+  }
+  for (int run = 0; run < 2; ++run) {
+    ASSERT_EQ(executor.forward(), loss->value_);
+  }
+  executor.backward();
+  for (size_t k = 0; k < w.size(); ++k) {
+    ASSERT_FLOAT_EQ(replayed[k]->grad_, eager[k]->grad_) << k;
+  }
+  ASSERT_THROW(GraphExecutor<double> wrong_dtype(graph.view()),
+               std::runtime_error);
+}
+
+TEST(MappedGraph, RejectsCorruptFiles) {
+  auto path = testing::TempDir() + "corrupt.graph";
+  auto x = variable(2.0f);
+  GraphCapture<float> capture;
+  auto z = x * x + x;
+  capture.finish(z).save(path);
+
+  std::string contents;
+  {
+    std::ifstream in(path, std::ios::binary);
+    contents.assign(std::istreambuf_iterator<char>(in), {});
+  }
+  auto write = [&](const std::string &data) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(data.data(), data.size());
+  };
+
+  // Make the first edge of the root point forward.
+  auto corrupt = contents;
+  auto header = reinterpret_cast<autograd::GraphHeader *>(&corrupt[0]);
+  uint32_t root_edges = reinterpret_cast<uint32_t *>(
+      &corrupt[header->edge_offsets_offset])[header->root];
+  reinterpret_cast<uint32_t *>(&corrupt[header->edges_offset])[root_edges] =
+      header->root;
+  write(corrupt);
+  ASSERT_THROW(MappedGraph graph(path), std::runtime_error);
+
+  // Move one of the two saved inputs of x * x to the Add.
+  corrupt = contents;
+  header = reinterpret_cast<autograd::GraphHeader *>(&corrupt[0]);
+  auto saved_offsets =
+      reinterpret_cast<uint32_t *>(&corrupt[header->saved_offsets_offset]);
+  ASSERT_EQ(saved_offsets[header->root + 1] - saved_offsets[header->root], 0);
+  --saved_offsets[header->root];
+  write(corrupt);
+  ASSERT_THROW(MappedGraph graph(path), std::runtime_error);
+}
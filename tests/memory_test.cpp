@@ -0,0 +1,94 @@
+#include <autograd/autograd.h>
+#include <autograd/memory.h>
+#include <autograd/variable.h>
+#include <gtest/gtest.h>
+
+using autograd::OpCode;
+using autograd::Variable;
+using autograd::variable;
+
+TEST(MemoryStats, CountsLiveObjects) {
+  auto before = autograd::memory_stats();
+  {
+    auto x = variable(2.0f);
+    auto y = variable(3.0f);
+    auto z = x * y + x;
+    auto during = autograd::memory_stats();
+    // x * y is not saved by AddBackward, so it is already gone.
+    ASSERT_EQ(during.variables.count - before.variables.count, 3);
+    ASSERT_EQ(during.variables.bytes - before.variables.bytes,
+              3 * sizeof(Variable));
+    // AddBackward, MulBackward and an AccumulateGrad for x and for y.
+    ASSERT_EQ(during.nodes.count - before.nodes.count, 4);
+    auto add = (int)OpCode::Add, accumulate = (int)OpCode::AccumulateGrad;
+    ASSERT_EQ(during.nodes_by_op[add].count - before.nodes_by_op[add].count,
+              1);
+    ASSERT_EQ(during.nodes_by_op[accumulate].count -
+                  before.nodes_by_op[accumulate].count,
+              2);
+    ASSERT_EQ(during.edges.count - before.edges.count, 4);
+    ASSERT_GE(during.nodes.peak_count, during.nodes.count);
+    autograd::run_backward(*z);
+  }
+  auto after = autograd::memory_stats();
+  ASSERT_EQ(after.variables.count, before.variables.count);
+  ASSERT_EQ(after.variables.bytes, before.variables.bytes);
+  ASSERT_EQ(after.nodes.count, before.nodes.count);
+  ASSERT_EQ(after.nodes.bytes, before.nodes.bytes);
+  ASSERT_EQ(after.edges.count, before.edges.count);
+  ASSERT_GE(after.nodes.peak_count, before.nodes.count + 4);
+
+  autograd::reset_peak_memory_stats();
+  auto reset = autograd::memory_stats();
+  ASSERT_EQ(reset.nodes.peak_count, reset.nodes.count);
+  ASSERT_EQ(reset.variables.peak_bytes, reset.variables.bytes);
+}
+
+TEST(GraphStats, Shape) {
+  auto x = variable(2.0f);
+  auto y = variable(3.0f);
+  auto z = x * y + x;
+  auto stats = autograd::graph_stats(*z);
+  ASSERT_EQ(stats.nodes, 4);
+  ASSERT_EQ(stats.edges, 4);
+  // Add -> Mul -> AccumulateGrad(x), and Add -> AccumulateGrad(x) directly:
+  // three levels.
+  ASSERT_EQ(stats.depth, 3);
+  ASSERT_EQ(stats.width, 2);
+  ASSERT_EQ(stats.fan_in, (std::vector<size_t>{1, 2, 1}));
+  ASSERT_EQ(stats.fan_out, (std::vector<size_t>{2, 0, 2}));
+  ASSERT_EQ(stats.saved_bytes, 2 * sizeof(Variable));
+  ASSERT_EQ(stats.nodes_by_op[(int)OpCode::Mul], 1);
+  ASSERT_EQ(stats.nodes_by_op[(int)OpCode::AccumulateGrad], 2);
+}
+
+TEST(GraphStats, LongChain) {
+  auto x = variable(1.0f);
+  auto y = x;
+  for (int i = 0; i < 1000; ++i) {
+    y = -y;
+  }
+  auto stats = autograd::graph_stats(*y);
+  ASSERT_EQ(stats.nodes, 1001);
+  ASSERT_EQ(stats.depth, 1001);
+  ASSERT_EQ(stats.width, 1);
+  ASSERT_EQ(stats.saved_bytes, 0);
+}
+
+class SquareBackward : public autograd::BasicNode<float> {
+public:
+  autograd::variable_list<float>
+  apply(autograd::variable_list<float> &&grads) override {
+    return grads;
+  }
+};
+
+TEST(MemoryStats, CustomNodes) {
+  auto custom = (int)OpCode::Custom;
+  auto before = autograd::memory_stats().nodes_by_op[custom].count;
+  auto node = std::make_shared<SquareBackward>();
+  ASSERT_EQ(autograd::memory_stats().nodes_by_op[custom].count, before + 1);
+  auto stats = autograd::graph_stats(node);
+  ASSERT_EQ(stats.nodes_by_op[custom], 1);
+  ASSERT_EQ(stats.node_bytes, sizeof(autograd::BasicNode<float>));
+}
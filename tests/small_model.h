@@ -0,0 +1,34 @@
+#if !defined(__SMALL_MODEL_H__)
+#define __SMALL_MODEL_H__
+
+#include <autograd/variable.h>
+#include <memory>
+#include <vector>
+
+// A 2-2-1 network shared by the tests of the alternative execution modes,
+// which compare their gradients against the graph engine.
+using Parameters = std::vector<std::shared_ptr<autograd::Variable>>;
+
+inline Parameters make_parameters(float scale) {
+  Parameters parameters;
+  for (int i = 0; i < 9; ++i) {
+    parameters.push_back(autograd::variable(scale * (i - 4)));
+  }
+  return parameters;
+}
+
+// A sigmoid and a ReLU hidden unit and a BCE-style loss.
+inline std::shared_ptr<autograd::Variable>
+forward(const Parameters &w, float x1v, float x2v, float target) {
+  using autograd::variable;
+  auto x1 = variable(x1v)->detach();
+  auto x2 = variable(x2v)->detach();
+  auto y = variable(target)->detach();
+  auto h1 = (w[0] * x1 + w[1] * x2 + w[2])->sigmoid();
+  auto h2 = (w[3] * x1 + w[4] * x2 + w[5])->relu();
+  auto out = (w[6] * h1 + w[7] * h2 + w[8])->sigmoid();
+  auto one = variable(1.0f)->detach();
+  return -(y * out->log()) - ((one - y) * (one - out)->log());
+}
+
+#endif // __SMALL_MODEL_H__
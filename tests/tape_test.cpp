@@ -0,0 +1,140 @@
+#include <autograd/autograd.h>
+#include <autograd/tape.h>
+#include <autograd/variable.h>
+#include <gtest/gtest.h>
+
+#include "small_model.h"
+
+using autograd::Tape;
+using autograd::Variable;
+using autograd::variable;
+
+TEST(Tape, MatchesGraphEngine) {
+  auto w = make_parameters(0.1f);
+  auto loss = forward(w, 1.0f, -2.0f, 1.0f);
+  autograd::run_backward(*loss);
+
+  auto taped = make_parameters(0.1f);
+  Tape<float> tape;
+  auto taped_loss = forward(taped, 1.0f, -2.0f, 1.0f);
+  ASSERT_FALSE(taped_loss->gradient_edge_.grad_fn());
+  ASSERT_EQ(taped_loss->value_, loss->value_);
+  autograd::run_backward(*taped_loss);
+  for (size_t k = 0; k < w.size(); ++k) {
+    ASSERT_FLOAT_EQ(taped[k]->grad_, w[k]->grad_) << k;
+  }
+}
+
+TEST(Tape, RecordsOnlyOperators) {
+  auto x = variable(3.0f);
+  auto y = variable(2.0f);
+  Tape<float> tape;
+  auto z = x * y + x;
+  ASSERT_EQ(tape.records().size(), 2);
+  ASSERT_EQ(tape.num_slots(), 4);
+  autograd::run_backward(*z);
+  ASSERT_FLOAT_EQ(x->grad_, 3.0f);
+  ASSERT_FLOAT_EQ(y->grad_, 3.0f);
+}
+
+TEST(Tape, BackwardFromIntermediate) {
+  auto x = variable(3.0f);
+  auto y = variable(2.0f);
+  Tape<float> tape;
+  auto z = x * y;
+  auto unused = z * z * z;
+  autograd::run_backward(*z, 2.0f);
+  ASSERT_FLOAT_EQ(x->grad_, 4.0f);
+  ASSERT_FLOAT_EQ(y->grad_, 6.0f);
+}
+
+TEST(Tape, ClearStartsOver) {
+  auto w = variable(2.0f);
+  auto frozen = variable(5.0f);
+  frozen->set_requires_grad(false);
+  Tape<float> tape;
+  for (int i = 0; i < 3; ++i) {
+    w->zero_grad();
+    auto loss = w * w * frozen;
+    autograd::run_backward(*loss);
+    ASSERT_FLOAT_EQ(w->grad_, 2.0f * 5.0f * w->value_);
+    ASSERT_FLOAT_EQ(frozen->grad_, 0.0f);
+    w->value_ -= 0.1f;
+    tape.clear();
+    ASSERT_FALSE(tape.contains(*loss));
+  }
+}
+
+TEST(Tape, StopRestoresGraphEngine) {
+  auto x = variable(3.0f);
+  Tape<float> tape;
+  auto taped = x * x;
+  tape.stop();
+  ASSERT_EQ(Tape<float>::current(), nullptr);
+  auto eager = x * x;
+  ASSERT_TRUE(eager->gradient_edge_.grad_fn());
+  tape.backward(*taped);
+  ASSERT_FLOAT_EQ(x->grad_, 6.0f);
+  ASSERT_THROW(tape.backward(*eager), std::runtime_error);
+}
+
+TEST(Tape, Nesting) {
+  auto outer = std::make_unique<Tape<float>>();
+  auto middle = std::make_unique<Tape<float>>();
+  {
+    Tape<float> inner;
+    ASSERT_EQ(Tape<float>::current(), &inner);
+  }
+  ASSERT_EQ(Tape<float>::current(), middle.get());
+  // Out of order: the middle tape stays current until it is stopped.
+  outer.reset();
+  ASSERT_EQ(Tape<float>::current(), middle.get());
+  middle->stop();
+  ASSERT_EQ(Tape<float>::current(), nullptr);
+  middle.reset();
+  ASSERT_EQ(Tape<float>::current(), nullptr);
+}
+
+TEST(Tape, BackwardOnEnclosingTape) {
+  auto x = variable(3.0f);
+  Tape<float> outer;
+  auto y = x * x;
+  {
+    Tape<float> inner;
+    // y is an input of the inner tape, it stays on the outer one.
+    auto z = y * x;
+    ASSERT_TRUE(outer.contains(*y));
+    autograd::run_backward(*y);
+    ASSERT_FLOAT_EQ(x->grad_, 6.0f);
+    // For the inner tape y is a leaf, the gradient stops there.
+    autograd::run_backward(*z);
+    ASSERT_FLOAT_EQ(x->grad_, 6.0f + 9.0f);
+    ASSERT_FLOAT_EQ(y->grad_, 3.0f);
+  }
+  x->zero_grad();
+  autograd::run_backward(*y);
+  ASSERT_FLOAT_EQ(x->grad_, 6.0f);
+}
+
+TEST(Tape, RejectsFinishedTapes) {
+  auto x = variable(3.0f);
+  std::shared_ptr<Variable> y;
+  {
+    Tape<float> tape;
+    y = x * x;
+    tape.clear();
+    ASSERT_THROW(autograd::run_backward(*y), std::runtime_error);
+  }
+  ASSERT_THROW(autograd::run_backward(*y), std::runtime_error);
+  // Inputs of a finished tape are still leaves of the graph engine.
+  autograd::run_backward(*x);
+  ASSERT_FLOAT_EQ(x->grad_, 1.0f);
+}
+
+TEST(Tape, AccumulatesHalfInFloat) {
+  auto x = variable<autograd::half>(0.5f);
+  Tape<autograd::half> tape;
+  auto y = x->log() * x;
+  autograd::run_backward(*y);
+  ASSERT_NEAR(x->grad_, std::log(0.5f) + 1.0f, 1e-3);
+}
@@ -0,0 +1,79 @@
+// Starts N copies of a training program on this host, wired together through
+// a shared-memory segment (see autograd::ShmCommunicator::from_env).
+//
+//   autograd_launch --nproc 4 ./train --epochs 10
+
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fmt/format.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+int main(int argc, char **argv) {
+  int nproc = 0;
+  int i = 1;
+  for (; i < argc; ++i) {
+    if (!std::strcmp(argv[i], "--nproc") && i + 1 < argc) {
+      nproc = std::atoi(argv[++i]);
+    } else if (!std::strcmp(argv[i], "--")) {
+      ++i;
+      break;
+    } else {
+      break;
+    }
+  }
+  if (nproc <= 0 || i >= argc) {
+    fmt::print(stderr, "usage: {} --nproc N program [args...]\n", argv[0]);
+    return 2;
+  }
+
+  std::string name = fmt::format("/autograd_{}", getpid());
+  shm_unlink(name.c_str());
+
+  std::vector<pid_t> children;
+  for (int rank = 0; rank < nproc; ++rank) {
+    pid_t pid = fork();
+    if (pid < 0) {
+      fmt::print(stderr, "fork failed: {}\n", std::strerror(errno));
+      for (pid_t child : children) {
+        kill(child, SIGTERM);
+      }
+      return 1;
+    }
+    if (pid == 0) {
+      setenv("AUTOGRAD_SHM_NAME", name.c_str(), 1);
+      setenv("AUTOGRAD_RANK", std::to_string(rank).c_str(), 1);
+      setenv("AUTOGRAD_WORLD_SIZE", std::to_string(nproc).c_str(), 1);
+      execvp(argv[i], argv + i);
+      fmt::print(stderr, "exec {} failed: {}\n", argv[i], std::strerror(errno));
+      _exit(127);
+    }
+    children.push_back(pid);
+  }
+
+  int exit_code = 0;
+  for (size_t remaining = children.size(); remaining > 0; --remaining) {
+    int status = 0;
+    pid_t pid = wait(&status);
+    if (pid < 0) {
+      break;
+    }
+    bool failed = !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+    if (failed && exit_code == 0) {
+      // A dead rank would leave the others spinning in a barrier forever.
+      exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+      for (pid_t child : children) {
+        if (child != pid) {
+          kill(child, SIGTERM);
+        }
+      }
+    }
+  }
+  shm_unlink(name.c_str());
+  return exit_code;
+}